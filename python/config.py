@@ -1,11 +1,20 @@
 import sys
 
+# Commands go to the ST-Link virtual COM port of the Nucleo (USART2), telemetry is read from
+# a USB-serial adapter on USART3. If the firmware is built with SERIAL_SPLIT_PORTS 0, both
+# go through USART3: set both names to the same device.
 if sys.platform == 'win32':
-    # Don't forget to setup the COM port splitter before writing both port names
     USB_DEV_TELEM = "COM1"
     USB_DEV_CMD = "COM2"
 else:
     USB_DEV_TELEM = "/dev/ttyUSB0"
-    USB_DEV_CMD = "/dev/ttyUSB0"
+    USB_DEV_CMD = "/dev/ttyACM0"
 
-BAUDRATE = 115200
+SPLIT_PORTS = USB_DEV_TELEM != USB_DEV_CMD
+
+# The telemetry link boots at BAUDRATE_BOOT, start_logging.py then switches it to BAUDRATE
+BAUDRATE_BOOT = 115200
+BAUDRATE = 921600
+
+# The command port keeps its rate, unless it shares the telemetry link
+BAUDRATE_CMD = 115200 if SPLIT_PORTS else BAUDRATE
@@ -0,0 +1,84 @@
+import os
+import re
+
+# Generates si_commands.py, the encoders of the host commands, from the command table of the
+# device (SI_COMMAND_TABLE in si_commands.hh) and its parameter table (PARAM_TABLE in
+# param_server.hh). Run after changing a table:
+#   python gen_commands.py
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+HEADERS = [os.path.join(ROOT, '..', 'stm32', 'Core', 'Drivers', 'Inc', name)
+           for name in ('si_commands.hh', 'param_server.hh')]
+OUTPUT = os.path.join(ROOT, 'si_commands.py')
+
+# struct formats of the payload field types
+FIELD_FORMATS = {
+    'float': 'f',
+    'int8_t': 'b',
+    'uint8_t': 'B',
+    'int16_t': 'h',
+    'uint16_t': 'H',
+    'int32_t': 'i',
+    'uint32_t': 'I',
+}
+
+def parse(header):
+    # Payload types and their fields
+    payloads = {}
+    for body, name in re.findall(r'typedef struct\s*\{([^}]*)\}\s*(\w+);', header):
+        payloads[name] = re.findall(r'(\w+)\s+(\w+);', body)
+
+    commands = re.findall(r'X\((CMD_\w+),\s*(0x[0-9A-Fa-f]+),\s*(\w+),\s*(\w+)\)', header)
+    params = re.findall(r'X\((PARAM_\w+),\s*(0x[0-9A-Fa-f]+),\s*(\w+),\s*(\w+),', header)
+
+    # Values of the other enums (statuses, payload fields), grouped by enum
+    enums = []
+    for body, _ in re.findall(r'typedef enum\s*\{([^}]*)\}\s*(\w+);', header):
+        values = re.findall(r'(\w+)\s*=\s*(0x[0-9A-Fa-f]+)', body)
+        if values and not any(name == 'CMD_NO_CMD' for name, _ in values):
+            enums.append(values)
+    return payloads, commands, params, enums
+
+def generate(payloads, commands, params, enums):
+    lines = [
+        '# Generated by gen_commands.py from stm32/Core/Drivers/Inc/si_commands.hh and param_server.hh, do not edit.',
+        '',
+        'import struct',
+        '',
+        'CMD_NO_CMD = 0x00',
+    ]
+    lines += [f'{code_enum} = {code}' for code_enum, code, _, _ in commands]
+    for values in enums:
+        lines += ['']
+        lines += [f'{name} = {value}' for name, value in values]
+    lines += ['']
+    lines += [f'{id_enum} = {id}' for id_enum, id, _, _ in params]
+    lines += ['']
+    lines += ['# Parameters by name: id and struct format of the value']
+    lines += ['PARAMS = {']
+    lines += [f"    '{member}': ({id_enum}, '{FIELD_FORMATS[param_type]}')," for id_enum, _, member, param_type in params]
+    lines += ['}']
+    lines += ['']
+
+    for code_enum, _, name, payload in commands:
+        fields = payloads[payload]
+        args = ', '.join(field for _, field in fields)
+        fmt = '<' + ''.join(FIELD_FORMATS[field_type] for field_type, _ in fields)
+        lines += [
+            '',
+            f'def {name}({args}):',
+            f'    """Returns the code and payload of {code_enum}."""',
+            f"    return {code_enum}, struct.pack('{fmt}'{', ' + args if args else ''})",
+        ]
+
+    return '\n'.join(lines) + '\n'
+
+if __name__ == '__main__':
+    header = ''
+    for path in HEADERS:
+        with open(path) as f:
+            header += f.read()
+    source = generate(*parse(header))
+    with open(OUTPUT, 'w', newline='\n') as f:
+        f.write(source)
+    print(f'Generated {OUTPUT}')
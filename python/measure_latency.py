@@ -0,0 +1,49 @@
+import serial
+import str_commands
+import si_commands
+import argparse
+import config
+import time
+
+# Sends set angle commands and reports the distribution of their acknowledgement latencies:
+# the host round trip time, and the time between the reception of a command by the device and
+# the application of its effect to the servo.
+
+parser = argparse.ArgumentParser()
+parser.add_argument('-n', '--count', type=int, default=200, help='number of commands')
+parser.add_argument('--interval', type=float, default=0.05, help='time between commands (s)')
+parser.add_argument('--angle', type=float, default=0.0, help='angle of the commands (deg)')
+args = parser.parse_args()
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(round(p / 100 * (len(values) - 1))))]
+
+def print_distribution(name, values, unit):
+    print(f"{name:<24} " + "  ".join(f"p{p}={percentile(values, p):.2f}{unit}" for p in (0, 50, 90, 99, 100)))
+
+ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
+
+rtt_ms = []
+device_ms = []
+lost = 0
+rejected = 0
+
+for i in range(args.count):
+    sequence = str_commands.set_angle(ser, args.angle)
+    ack = str_commands.wait_ack(ser, sequence)
+    if ack is None:
+        lost += 1
+    else:
+        if ack.status != si_commands.CMD_STATUS_OK:
+            rejected += 1
+        rtt_ms.append(ack.rtt_s * 1e3)
+        device_ms.append(((ack.applied_us - ack.received_us) & 0xFFFFFFFF) / 1e3)
+    time.sleep(args.interval)
+
+ser.close()                         # close port
+
+print(f"{args.count} commands, {len(rtt_ms)} acknowledged, {rejected} rejected, {lost} lost")
+if rtt_ms:
+    print_distribution("Round trip", rtt_ms, "ms")
+    print_distribution("Receive to apply", device_ms, "ms")
@@ -0,0 +1,70 @@
+import serial
+import str_commands
+import si_commands
+import telemetry.telem as telem
+import argparse
+import config
+import struct
+
+# Reads and tunes the parameters of the device at runtime (filter window, telemetry debug
+# channels and period, sensor calibration). Values are set in RAM, "save" writes them to flash
+# so that they are restored at startup.
+
+PARAM_NAMES = {param_id: name for name, (param_id, _) in si_commands.PARAMS.items()}
+
+def to_raw(fmt, value):
+    """Returns the raw 4 bytes of a value, as the u32 of the set command."""
+    return struct.unpack('<I', struct.pack('<' + fmt, value))[0]
+
+def from_raw(fmt, raw):
+    return struct.unpack('<' + fmt, struct.pack('<I', raw))[0]
+
+def parse_value(fmt, text):
+    return float(text) if fmt == 'f' else int(text, 0)
+
+def print_param(msg):
+    """Prints a MSG_TAG.PARAM_VALUE message."""
+    if msg[0] != telem.MSG_TAG.PARAM_VALUE or len(msg) != 19:
+        return
+    param_id, _, *raws = struct.unpack('<BBIIII', msg[1:])
+    name = PARAM_NAMES.get(param_id, f"0x{param_id:02X}")
+    fmt = si_commands.PARAMS[name][1] if name in si_commands.PARAMS else 'I'
+    value, low, high, default = (from_raw(fmt, raw) for raw in raws)
+    print(f"{name:<28} {value:<12.6g} [{low:.6g}, {high:.6g}] default {default:.6g}")
+
+def request(ser: serial.Serial, command):
+    """Sends a parameter command, prints the values sent back and the acknowledgement."""
+    sequence = str_commands.send_command(ser, *command)
+    ack = str_commands.wait_ack(ser, sequence, on_message=print_param)
+    if ack is None:
+        print("No acknowledgement")
+    elif ack.status != si_commands.CMD_STATUS_OK:
+        print(f"Not applied: {str_commands.CMD_STATUS_NAMES.get(ack.status)}")
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    subparsers = parser.add_subparsers(dest='action', required=True)
+    subparsers.add_parser('list', help='print all the parameters')
+    subparsers.add_parser('get', help='print a parameter').add_argument('name', choices=si_commands.PARAMS)
+    set_parser = subparsers.add_parser('set', help='set a parameter in RAM')
+    set_parser.add_argument('name', choices=si_commands.PARAMS)
+    set_parser.add_argument('value')
+    subparsers.add_parser('save', help='save the current values to flash')
+    subparsers.add_parser('reset', help='restore the default values in RAM')
+    args = parser.parse_args()
+
+    ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
+
+    if args.action == 'list':
+        request(ser, si_commands.param_list())
+    elif args.action == 'get':
+        request(ser, si_commands.param_get(si_commands.PARAMS[args.name][0]))
+    elif args.action == 'set':
+        param_id, fmt = si_commands.PARAMS[args.name]
+        request(ser, si_commands.param_set(param_id, to_raw(fmt, parse_value(fmt, args.value))))
+    elif args.action == 'save':
+        request(ser, si_commands.param_save())
+    elif args.action == 'reset':
+        request(ser, si_commands.param_reset())
+
+    ser.close()                         # close port
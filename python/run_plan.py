@@ -0,0 +1,90 @@
+import serial
+import str_commands
+import si_commands
+import argparse
+import config
+import json
+
+# Uploads a test plan to the device and starts it. The device then runs the plan on its own,
+# the progress is reported in the telemetry (MSG_TAG.TEST_PLAN).
+#
+# A plan is a JSON list of steps, run in order:
+#   {"step": "set_angle", "angle_deg": 0}
+#   {"step": "sine", "angle_min_deg": -15, "angle_max_deg": 15, "period_s": 2, "duration_s": 60}
+#   {"step": "sweep", "angle_min_deg": -15, "angle_max_deg": 15, "period_min_s": 1, "period_max_s": 5,
+#    "n_periods": 10, "n_cycles_per_period": 3}
+#   {"step": "hold", "duration_s": 10}
+#   {"step": "wait", "condition": "temperature_below", "threshold": 40, "timeout_s": 600}
+#   {"step": "loop", "to": 0, "count": 100}
+# "loop" jumps back to the step at index "to", "count" times. "wait" conditions are
+# temperature_below, temperature_above (degC) and current_below (A), the plan is aborted after
+# "timeout_s" (0: no timeout).
+
+CONDITIONS = {
+    'temperature_below': si_commands.PLAN_COND_TEMPERATURE_BELOW,
+    'temperature_above': si_commands.PLAN_COND_TEMPERATURE_ABOVE,
+    'current_below': si_commands.PLAN_COND_CURRENT_BELOW,
+}
+
+def encode_step(index, step):
+    """Returns the code and payload of the CMD_PLAN_ADD_STEP command of a step."""
+    kind = step['step']
+    values = [0.0] * 4
+    duration_ms = 0
+    counts = [0, 0]
+
+    if kind == 'set_angle':
+        step_type = si_commands.PLAN_STEP_SET_ANGLE
+        values[0] = step['angle_deg']
+    elif kind == 'sine':
+        step_type = si_commands.PLAN_STEP_SINE
+        values[:3] = step['angle_min_deg'], step['angle_max_deg'], step['period_s']
+        duration_ms = round(step['duration_s'] * 1000)
+    elif kind == 'sweep':
+        step_type = si_commands.PLAN_STEP_SWEEP
+        values = [step['angle_min_deg'], step['angle_max_deg'], step['period_min_s'], step['period_max_s']]
+        counts = [step['n_periods'], step['n_cycles_per_period']]
+    elif kind == 'hold':
+        step_type = si_commands.PLAN_STEP_HOLD
+        duration_ms = round(step['duration_s'] * 1000)
+    elif kind == 'wait':
+        step_type = si_commands.PLAN_STEP_WAIT
+        values[0] = step['threshold']
+        duration_ms = round(step.get('timeout_s', 0) * 1000)
+        counts[0] = CONDITIONS[step['condition']]
+    elif kind == 'loop':
+        step_type = si_commands.PLAN_STEP_LOOP
+        counts = [step['to'], step['count']]
+    else:
+        raise ValueError(f"Unknown step '{kind}'")
+
+    return si_commands.plan_add_step(index, step_type, *values, duration_ms, *counts)
+
+def upload(ser: serial.Serial, steps):
+    """Replaces the plan of the device, returns True if every step was accepted."""
+    commands = [si_commands.plan_clear()] + [encode_step(i, step) for i, step in enumerate(steps)]
+    for i, command in enumerate(commands):
+        ack = str_commands.wait_ack(ser, str_commands.send_command(ser, *command))
+        if ack is None or ack.status != si_commands.CMD_STATUS_OK:
+            status = "no acknowledgement" if ack is None else str_commands.CMD_STATUS_NAMES.get(ack.status)
+            print(f"Step {i - 1} not accepted: {status}" if i > 0 else f"Plan not cleared: {status}")
+            return False
+    return True
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('plan', help='JSON test plan')
+    parser.add_argument('--no-start', action='store_true', help='upload the plan without starting it')
+    args = parser.parse_args()
+
+    with open(args.plan) as f:
+        steps = json.load(f)
+
+    ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
+
+    if upload(ser, steps):
+        print(f"Uploaded {len(steps)} steps")
+        if not args.no_start:
+            str_commands.print_ack(ser, str_commands.send_command(ser, *si_commands.plan_start()))
+
+    ser.close()                         # close port
@@ -0,0 +1,39 @@
+import serial
+import str_commands
+import argparse
+import config
+
+# Pre-loads a sequence of set angle commands, each executed on the control step at its time
+# regardless of the link latency. Times are relative to the start of the sequence.
+
+parser = argparse.ArgumentParser()
+parser.add_argument('setpoints', nargs='+', help='<time_s>:<angle_deg> pairs, at most 16')
+parser.add_argument('--lead', type=float, default=0.2, help='delay before the start of the sequence (s)')
+args = parser.parse_args()
+
+# Sorted, the acknowledgements arrive in execution order
+setpoints = sorted(tuple(float(v) for v in setpoint.split(':')) for setpoint in args.setpoints)
+
+ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
+
+start_us = str_commands.device_time_us(ser)
+if start_us is None:
+    raise SystemExit("No answer from the device")
+start_us += int(args.lead * 1e6)
+
+sequences = {}
+for time_s, angle_deg in setpoints:
+    execute_us = (start_us + int(time_s * 1e6)) & 0xFFFFFFFF
+    sequences[str_commands.set_angle(ser, angle_deg, execute_us=execute_us)] = (time_s, angle_deg, execute_us)
+
+for sequence, (time_s, angle_deg, execute_us) in sequences.items():
+    ack = str_commands.wait_ack(ser, sequence, args.lead + time_s + str_commands.ACK_TIMEOUT_S)
+    if ack is None:
+        print(f"{time_s:8.3f}s {angle_deg:7.2f}deg: not acknowledged")
+        continue
+    status = str_commands.CMD_STATUS_NAMES.get(ack.status, f"status {ack.status}")
+    delay_us = ack.applied_us - execute_us
+    delay_us = delay_us - (1 << 32) if delay_us >= (1 << 31) else delay_us
+    print(f"{time_s:8.3f}s {angle_deg:7.2f}deg: {status}, applied {delay_us}us after its time")
+
+ser.close()                         # close port
@@ -7,11 +7,13 @@ parser = argparse.ArgumentParser()
 parser.add_argument('angle_deg', default='0.0')
 args = parser.parse_args()
 
-ser = serial.Serial(config.USB_DEV_CMD,  config.BAUDRATE) # open serial port
+ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
 
-str_commands.set_angle(
+sequence = str_commands.set_angle(
     ser, 
     float(args.angle_deg),
 )
 
+str_commands.print_ack(ser, sequence)
+
 ser.close()                         # close port
@@ -0,0 +1,26 @@
+import serial
+import str_commands
+import si_commands
+import argparse
+import config
+
+# Sets the offsets within each 20ms PWM frame at which the servo current profile is sampled
+# (MSG_TAG.CURRENT_PROFILE). Not saved, the device restarts with its default offsets.
+
+MAX_POINTS = 8
+
+parser = argparse.ArgumentParser()
+parser.add_argument('offsets_us', type=int, nargs='+', help='offsets from the frame start (us), ascending')
+args = parser.parse_args()
+
+if len(args.offsets_us) > MAX_POINTS:
+    parser.error(f"at most {MAX_POINTS} offsets")
+
+ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
+
+offsets_us = args.offsets_us + [0] * (MAX_POINTS - len(args.offsets_us))
+sequence = str_commands.send_command(ser, *si_commands.current_profile_offsets(len(args.offsets_us), *offsets_us))
+
+str_commands.print_ack(ser, sequence)
+
+ser.close()                         # close port
@@ -0,0 +1,122 @@
+# Generated by gen_commands.py from stm32/Core/Drivers/Inc/si_commands.hh and param_server.hh, do not edit.
+
+import struct
+
+CMD_NO_CMD = 0x00
+CMD_SERVO_STOP = 0x01
+CMD_SERVO_SET_ANGLE = 0x02
+CMD_SERVO_START_SIN = 0x03
+CMD_SERVO_START_SIN_SWEEP = 0x05
+CMD_SERIAL_SET_BAUDRATE = 0x07
+CMD_SERIAL_PING = 0x08
+CMD_PLAN_CLEAR = 0x09
+CMD_PLAN_ADD_STEP = 0x0A
+CMD_PLAN_START = 0x0B
+CMD_PARAM_GET = 0x0C
+CMD_PARAM_SET = 0x0D
+CMD_PARAM_LIST = 0x0E
+CMD_PARAM_SAVE = 0x0F
+CMD_PARAM_RESET = 0x10
+CMD_CURRENT_PROFILE_OFFSETS = 0x11
+
+CMD_STATUS_OK = 0x00
+CMD_STATUS_REJECTED = 0x01
+CMD_STATUS_UNSUPPORTED = 0x02
+CMD_STATUS_SCHEDULE_FULL = 0x03
+
+PLAN_STEP_SET_ANGLE = 0x00
+PLAN_STEP_SINE = 0x01
+PLAN_STEP_SWEEP = 0x02
+PLAN_STEP_HOLD = 0x03
+PLAN_STEP_WAIT = 0x04
+PLAN_STEP_LOOP = 0x05
+
+PLAN_COND_TEMPERATURE_BELOW = 0x00
+PLAN_COND_TEMPERATURE_ABOVE = 0x01
+PLAN_COND_CURRENT_BELOW = 0x02
+
+PARAM_TYPE_U32 = 0x00
+PARAM_TYPE_I32 = 0x01
+PARAM_TYPE_F32 = 0x02
+
+PARAM_MAG_FILTER_WINDOW = 0x00
+PARAM_TELEM_DEBUG_CHANNELS = 0x01
+PARAM_TELEM_STREAM_STATUS_PERIOD = 0x02
+PARAM_VOLTAGE_GAIN = 0x03
+PARAM_VOLTAGE_OFFSET_V = 0x04
+PARAM_CURRENT_GAIN = 0x05
+PARAM_CURRENT_OFFSET_A = 0x06
+PARAM_LOAD_CELL_GAIN = 0x07
+
+# Parameters by name: id and struct format of the value
+PARAMS = {
+    'mag_filter_window': (PARAM_MAG_FILTER_WINDOW, 'I'),
+    'telem_debug_channels': (PARAM_TELEM_DEBUG_CHANNELS, 'I'),
+    'telem_stream_status_period': (PARAM_TELEM_STREAM_STATUS_PERIOD, 'I'),
+    'voltage_gain': (PARAM_VOLTAGE_GAIN, 'f'),
+    'voltage_offset_v': (PARAM_VOLTAGE_OFFSET_V, 'f'),
+    'current_gain': (PARAM_CURRENT_GAIN, 'f'),
+    'current_offset_a': (PARAM_CURRENT_OFFSET_A, 'f'),
+    'load_cell_gain': (PARAM_LOAD_CELL_GAIN, 'I'),
+}
+
+
+def servo_stop():
+    """Returns the code and payload of CMD_SERVO_STOP."""
+    return CMD_SERVO_STOP, struct.pack('<')
+
+def servo_set_angle(angle_deg):
+    """Returns the code and payload of CMD_SERVO_SET_ANGLE."""
+    return CMD_SERVO_SET_ANGLE, struct.pack('<f', angle_deg)
+
+def servo_start_sin(angle_min_deg, angle_max_deg, period_s):
+    """Returns the code and payload of CMD_SERVO_START_SIN."""
+    return CMD_SERVO_START_SIN, struct.pack('<fff', angle_min_deg, angle_max_deg, period_s)
+
+def servo_start_sin_sweep(angle_min_deg, angle_max_deg, period_min_s, period_max_s, n_periods, n_cycles_per_period):
+    """Returns the code and payload of CMD_SERVO_START_SIN_SWEEP."""
+    return CMD_SERVO_START_SIN_SWEEP, struct.pack('<ffffII', angle_min_deg, angle_max_deg, period_min_s, period_max_s, n_periods, n_cycles_per_period)
+
+def serial_set_baudrate(baudrate):
+    """Returns the code and payload of CMD_SERIAL_SET_BAUDRATE."""
+    return CMD_SERIAL_SET_BAUDRATE, struct.pack('<I', baudrate)
+
+def serial_ping():
+    """Returns the code and payload of CMD_SERIAL_PING."""
+    return CMD_SERIAL_PING, struct.pack('<')
+
+def plan_clear():
+    """Returns the code and payload of CMD_PLAN_CLEAR."""
+    return CMD_PLAN_CLEAR, struct.pack('<')
+
+def plan_add_step(index, type, value_0, value_1, value_2, value_3, duration_ms, count_0, count_1):
+    """Returns the code and payload of CMD_PLAN_ADD_STEP."""
+    return CMD_PLAN_ADD_STEP, struct.pack('<BBffffIII', index, type, value_0, value_1, value_2, value_3, duration_ms, count_0, count_1)
+
+def plan_start():
+    """Returns the code and payload of CMD_PLAN_START."""
+    return CMD_PLAN_START, struct.pack('<')
+
+def param_get(id):
+    """Returns the code and payload of CMD_PARAM_GET."""
+    return CMD_PARAM_GET, struct.pack('<B', id)
+
+def param_set(id, value):
+    """Returns the code and payload of CMD_PARAM_SET."""
+    return CMD_PARAM_SET, struct.pack('<BI', id, value)
+
+def param_list():
+    """Returns the code and payload of CMD_PARAM_LIST."""
+    return CMD_PARAM_LIST, struct.pack('<')
+
+def param_save():
+    """Returns the code and payload of CMD_PARAM_SAVE."""
+    return CMD_PARAM_SAVE, struct.pack('<')
+
+def param_reset():
+    """Returns the code and payload of CMD_PARAM_RESET."""
+    return CMD_PARAM_RESET, struct.pack('<')
+
+def current_profile_offsets(n_points, offset_0_us, offset_1_us, offset_2_us, offset_3_us, offset_4_us, offset_5_us, offset_6_us, offset_7_us):
+    """Returns the code and payload of CMD_CURRENT_PROFILE_OFFSETS."""
+    return CMD_CURRENT_PROFILE_OFFSETS, struct.pack('<BHHHHHHHH', n_points, offset_0_us, offset_1_us, offset_2_us, offset_3_us, offset_4_us, offset_5_us, offset_6_us, offset_7_us)
@@ -8,6 +8,7 @@ import serial_asyncio
 import config
 import struct
 import telemetry.telem as telem
+import str_commands
 import websockets
 import os
 
@@ -70,9 +71,14 @@ async def main():
 
   parser = argparse.ArgumentParser(description='Proxy data between LLFC serial connection and UDP.')
   parser.add_argument('--device', default=config.USB_DEV_TELEM)
-  parser.add_argument('--baudrate', default=115200)
+  parser.add_argument('--baudrate', type=int, default=config.BAUDRATE)
   args = parser.parse_args()
 
+  # Switch the link to the requested rate, the device boots at config.BAUDRATE_BOOT
+  baudrate = str_commands.negotiate_baudrate(args.device, args.baudrate, config.BAUDRATE_BOOT,
+                                            config.USB_DEV_CMD, config.BAUDRATE_CMD)
+  print(f"Serial link at {baudrate} baud")
+
   loop = asyncio.get_running_loop()
   terminate = loop.create_future()
 
@@ -159,7 +165,7 @@ async def main():
     loop,
     lambda: SerialProtocol(terminate),
     args.device,
-    args.baudrate,
+    baudrate,
     bytesize=8,
     parity='N',
     stopbits=1)
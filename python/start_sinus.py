@@ -9,13 +9,15 @@ parser.add_argument('angle_max_deg', default='30.0')
 parser.add_argument('period_s', default='2.0')
 args = parser.parse_args()
 
-ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE) # open serial port
+ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
 
-str_commands.start_sinusoidal(
+sequence = str_commands.start_sinusoidal(
     ser, 
     float(args.angle_min_deg), 
     float(args.angle_max_deg), 
     float(args.period_s)
 )
 
+str_commands.print_ack(ser, sequence)
+
 ser.close()                         # close port
\ No newline at end of file
@@ -12,9 +12,9 @@ parser.add_argument('n_periods', default='10')
 parser.add_argument('n_cycles_per_per', default='5')
 args = parser.parse_args()
 
-ser = serial.Serial(config.USB_DEV_CMD,  config.BAUDRATE) # open serial port
+ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
 
-str_commands.start_sinusoidal_sweep(
+sequence = str_commands.start_sinusoidal_sweep(
     ser, 
     float(args.angle_min_deg), 
     float(args.angle_max_deg), 
@@ -24,4 +24,6 @@ str_commands.start_sinusoidal_sweep(
     int(args.n_cycles_per_per)
 )
 
+str_commands.print_ack(ser, sequence)
+
 ser.close()                         # close port
\ No newline at end of file
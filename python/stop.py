@@ -3,8 +3,10 @@ import str_commands
 import argparse
 import config
 
-ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE) # open serial port
+ser = serial.Serial(config.USB_DEV_CMD, config.BAUDRATE_CMD, timeout=str_commands.ACK_TIMEOUT_S) # open serial port
 
-str_commands.stop(ser)
+sequence = str_commands.stop(ser)
+
+str_commands.print_ack(ser, sequence)
 
 ser.close()    
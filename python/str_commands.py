@@ -1,35 +1,64 @@
+import collections
 import serial
 import struct
+import time
+from cobs import cobs
+import telemetry.telem as telem
+# Command codes and payload encoders, generated from the device command table (gen_commands.py)
+import si_commands
 
-FRAME_HEADER = 0xAB
+CMD_STATUS_NAMES = {
+    si_commands.CMD_STATUS_OK: "ok",
+    si_commands.CMD_STATUS_REJECTED: "rejected",
+    si_commands.CMD_STATUS_UNSUPPORTED: "unsupported",
+    si_commands.CMD_STATUS_SCHEDULE_FULL: "schedule full",
+}
 
-CMD_NO_CMD                      = 0x00
-CMD_SERVO_STOP                	= 0x01
-CMD_SERVO_SET_ANGLE             = 0x02
-CMD_SERVO_START_SIN             = 0x03
-CMD_SERVO_START_TRAP            = 0x04
-CMD_SERVO_START_SIN_SWEEP       = 0x05
-CMD_SERVO_START_TRAP_SWEEP      = 0x06
+# Set in the code of a command carrying its execution time (SI_CMD_FLAG_SCHEDULED)
+CMD_FLAG_SCHEDULED = 0x80
 
-def calculate_checksum(msg: bytes):
-    return sum(msg) & 0xFF
+# Commands are acknowledged within a control step (20ms) once received
+ACK_TIMEOUT_S = 0.5
 
+# Time given to the device to send its pending telemetry and switch
+BAUDRATE_SWITCH_DELAY_S = 0.2
+# Time to receive valid telemetry at the new rate, the device falls back after 1s without confirmation
+BAUDRATE_CHECK_TIMEOUT_S = 0.5
 
-def stop(ser: serial.Serial):
-    checksum = calculate_checksum(struct.pack("<B", CMD_SERVO_STOP))
-    frame = struct.pack("<BBB", FRAME_HEADER, CMD_SERVO_STOP, checksum)
-    ser.write(frame)
+# Acknowledgement of a command. received_us and applied_us are device timestamps, rtt_s is the
+# time between sending the command and receiving its acknowledgement on the host.
+CommandAck = collections.namedtuple('CommandAck', 'sequence command status received_us applied_us rtt_s')
 
-def set_angle(ser: serial.Serial, angle_deg: float):
-    msg_body = struct.pack("<Bf", CMD_SERVO_SET_ANGLE, angle_deg)
-    checksum = calculate_checksum(msg_body)
-    frame = struct.pack("<BBfB", FRAME_HEADER, CMD_SERVO_SET_ANGLE, angle_deg, checksum)
-    ser.write(frame)
+_sequence = 0
+_sent_s = {}
 
-def start_sinusoidal(ser: serial.Serial, angle_min_deg: float, angle_max_deg: float, period_s: float):
-    checksum = calculate_checksum(struct.pack("<Bfff", CMD_SERVO_START_SIN, angle_min_deg, angle_max_deg, period_s))
-    frame = struct.pack("<BBfffB", FRAME_HEADER, CMD_SERVO_START_SIN, angle_min_deg, angle_max_deg, period_s, checksum)
-    ser.write(frame)
+def send_command(ser: serial.Serial, cmd: int, payload: bytes = b'', execute_us: int = None):
+    """Sends a command and returns its sequence number, echoed in its acknowledgement.
+
+    If execute_us is given the device holds the command until the first control step at or after
+    this device time (see device_time_us()), and acknowledges it once executed.
+    """
+    global _sequence
+    _sequence = (_sequence + 1) & 0xFFFF
+    _sent_s[_sequence] = time.perf_counter()
+    header = struct.pack("<H", _sequence)
+    if execute_us is not None:
+        cmd |= CMD_FLAG_SCHEDULED
+        header += struct.pack("<I", execute_us & 0xFFFFFFFF)
+    # Same framing as the telemetry: COBS encoded code, sequence number, payload and CRC16. The
+    # leading framing byte terminates any partial frame left on the link.
+    ser.write(b'\x00' + telem.serialize_msg(cmd, header + payload))
+    return _sequence
+
+
+def stop(ser: serial.Serial, execute_us: int = None):
+    return send_command(ser, *si_commands.servo_stop(), execute_us=execute_us)
+
+def set_angle(ser: serial.Serial, angle_deg: float, execute_us: int = None):
+    return send_command(ser, *si_commands.servo_set_angle(angle_deg), execute_us=execute_us)
+
+def start_sinusoidal(ser: serial.Serial, angle_min_deg: float, angle_max_deg: float, period_s: float, execute_us: int = None):
+    return send_command(ser, *si_commands.servo_start_sin(angle_min_deg, angle_max_deg, period_s), execute_us=execute_us)
 
 def start_sinusoidal_sweep(ser: serial.Serial, 
                            angle_min_deg: float, 
@@ -37,33 +66,123 @@ def start_sinusoidal_sweep(ser: serial.Serial,
                            period_min_s: float, 
                            period_max_s: float,
                            n_periods: int,
-                           n_cycles_per_period: int):
+                           n_cycles_per_period: int,
+                           execute_us: int = None):
     
-    checksum = calculate_checksum(struct.pack(
-        "<Bffffii", 
-        CMD_SERVO_START_SIN_SWEEP, 
-        angle_min_deg, 
-        angle_max_deg, 
-        period_min_s,
-        period_max_s,
-        n_periods,
-        n_cycles_per_period)
-    )
-    frame = struct.pack(
-        "<BBffffiiB", 
-        FRAME_HEADER, 
-        CMD_SERVO_START_SIN_SWEEP, 
+    return send_command(ser, *si_commands.servo_start_sin_sweep(
         angle_min_deg, 
         angle_max_deg, 
         period_min_s,
         period_max_s,
         n_periods,
-        n_cycles_per_period, 
-        checksum
-    )
-    ser.write(frame)
-
-def start_trapezoidal(ser: serial.Serial, angle_min_deg: float, angle_max_deg: float, period_s: float, plateau_time_s):
-    checksum = calculate_checksum(struct.pack("<Bffff", CMD_SERVO_START_TRAP, angle_min_deg, angle_max_deg, period_s, plateau_time_s))
-    frame = struct.pack("<BBffffB", FRAME_HEADER, CMD_SERVO_START_TRAP, angle_min_deg, angle_max_deg, period_s, plateau_time_s, checksum)
-    ser.write(frame)
+        n_cycles_per_period
+    ), execute_us=execute_us)
+
+def set_baudrate(ser: serial.Serial, baudrate: int):
+    return send_command(ser, *si_commands.serial_set_baudrate(baudrate))
+
+def ping(ser: serial.Serial):
+    return send_command(ser, *si_commands.serial_ping())
+
+def read_message(ser: serial.Serial):
+    """Reads the next frame, returns its message (tag and body) or None if the frame is invalid."""
+    msg_cobs = ser.read_until(b'\x00')[:-1]
+    try:
+        msg_raw = cobs.decode(msg_cobs)
+    except cobs.DecodeError:
+        return None
+    if len(msg_raw) < 3 or telem.crc16_func(msg_raw) != 0:
+        return None
+    return msg_raw[:-2]
+
+def receives_telemetry(ser: serial.Serial, timeout_s: float):
+    """Returns True if a telemetry message with a valid CRC is received within timeout_s."""
+    ser.reset_input_buffer()
+    ser.read_until(b'\x00')  # synchronize on a framing byte
+    deadline = time.monotonic() + timeout_s
+    while time.monotonic() < deadline:
+        if read_message(ser) is not None:
+            return True
+    return False
+
+def wait_ack(ser: serial.Serial, sequence: int, timeout_s: float = ACK_TIMEOUT_S, on_message=None):
+    """Returns the CommandAck of the command with this sequence number, or None on timeout.
+
+    Acknowledgements are sent on the command port, among the telemetry if the port is shared.
+    The other messages received meanwhile are passed to on_message, if given, such as the
+    answers sent before the acknowledgement. ser needs a read timeout for the deadline to be
+    enforced.
+    """
+    deadline = time.monotonic() + timeout_s
+    while time.monotonic() < deadline:
+        msg = read_message(ser)
+        if msg is None:
+            continue
+        if msg[0] != telem.MSG_TAG.PILOT_CMD_ACK or len(msg) != 13:
+            if on_message is not None:
+                on_message(msg)
+            continue
+        ack_sequence, command, status, received_us, applied_us = struct.unpack('<HBBII', msg[1:])
+        if ack_sequence == sequence:
+            rtt_s = time.perf_counter() - _sent_s.pop(sequence, time.perf_counter())
+            return CommandAck(ack_sequence, command, status, received_us, applied_us, rtt_s)
+    return None
+
+def print_ack(ser: serial.Serial, sequence: int):
+    """Waits for the acknowledgement of a command and prints its status and latency."""
+    ack = wait_ack(ser, sequence)
+    if ack is None:
+        print(f"WARNING: command {sequence} not acknowledged within {ACK_TIMEOUT_S}s")
+        return None
+    status = CMD_STATUS_NAMES.get(ack.status, f"status {ack.status}")
+    print(f"Command {sequence}: {status}, round trip {ack.rtt_s * 1e3:.1f}ms, "
+          f"applied {(ack.applied_us - ack.received_us) & 0xFFFFFFFF}us after reception")
+    return ack
+
+def negotiate_baudrate(device: str, baudrate: int, boot_baudrate: int, cmd_device: str = None, cmd_baudrate: int = None):
+    """Switches the telemetry link on device to baudrate and returns the rate it ended up at.
+
+    The request is sent on the command port, the new rate is confirmed by repeating it once
+    telemetry is received at that rate. Without confirmation the device falls back to the
+    boot rate after 1 second. The command port is the telemetry port if cmd_device is None.
+    """
+    if baudrate == boot_baudrate:
+        return boot_baudrate
+
+    if cmd_device is None or cmd_device == device:
+        # Shared port, the request is sent at the boot rate and confirmed at the new rate
+        with serial.Serial(device, boot_baudrate, timeout=BAUDRATE_CHECK_TIMEOUT_S) as ser:
+            set_baudrate(ser, baudrate)
+            ser.flush()
+            time.sleep(BAUDRATE_SWITCH_DELAY_S)
+
+        with serial.Serial(device, baudrate, timeout=BAUDRATE_CHECK_TIMEOUT_S) as ser:
+            # Confirms the new rate, or requests it if the device already runs at this rate
+            set_baudrate(ser, baudrate)
+            ser.flush()
+            if receives_telemetry(ser, BAUDRATE_CHECK_TIMEOUT_S):
+                return baudrate
+    else:
+        with serial.Serial(cmd_device, cmd_baudrate) as ser_cmd:
+            set_baudrate(ser_cmd, baudrate)
+            ser_cmd.flush()
+            time.sleep(BAUDRATE_SWITCH_DELAY_S)
+
+            with serial.Serial(device, baudrate, timeout=BAUDRATE_CHECK_TIMEOUT_S) as ser:
+                if receives_telemetry(ser, BAUDRATE_CHECK_TIMEOUT_S):
+                    set_baudrate(ser_cmd, baudrate)
+                    ser_cmd.flush()
+                    return baudrate
+
+    print(f"WARNING: no telemetry at {baudrate} baud, falling back to {boot_baudrate} baud")
+    time.sleep(1.0)
+    return boot_baudrate
+
+def device_time_us(ser: serial.Serial):
+    """Estimates the current device time in us, from the acknowledgement of a ping, or None."""
+    ack = wait_ack(ser, ping(ser))
+    if ack is None:
+        return None
+    # The acknowledgement left at applied_us, about half of the link round trip ago
+    link_rtt_us = ack.rtt_s * 1e6 - ((ack.applied_us - ack.received_us) & 0xFFFFFFFF)
+    return (ack.applied_us + int(max(link_rtt_us, 0) / 2)) & 0xFFFFFFFF
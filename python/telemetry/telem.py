@@ -1,5 +1,6 @@
 from cobs import cobs
 import crcmod
+import collections
 import struct
 import types
 
@@ -18,7 +19,12 @@ MSG_TAG.LOG_SUFFIX = 0x04
 MSG_TAG.TIME_EPOCH = 0x11  # 17
 MSG_TAG.PILOT_CMD_ACK = 0x20
 MSG_TAG.VEHICLE_ARMED = 0x21
+MSG_TAG.STREAM_STATUS = 0x25
 MSG_TAG.TELEMETRY_MARKER_BUTTON = 0x26
+MSG_TAG.TEST_PLAN = 0x27
+MSG_TAG.PARAM_VALUE = 0x28
+MSG_TAG.RIG_STATE = 0x29
+MSG_TAG.SIMULTANEOUS_SAMPLES = 0x2B
 MSG_TAG.VEHICLE_ANGULAR_RATES = 0x30
 MSG_TAG.VEHICLE_ATTITUDE_QUAT = 0x31
 MSG_TAG.RATES_SETPOINT = 0x32
@@ -29,6 +35,9 @@ MSG_TAG.ODOMETRY = 0x42
 MSG_TAG.UBX = 0x50
 MSG_TAG.NMEA = 0x51
 MSG_TAG.GEIGER = 0x52
+MSG_TAG.TEMPERATURE = 0x55
+MSG_TAG.CURRENT_PROFILE = 0x56
+MSG_TAG.LOAD_CELL = 0x57
 MSG_TAG.IMU = 0x60
 MSG_TAG.GEOFENCE = 0x65
 MSG_TAG.SIM_LINK_FORCE_TORQUE = 0x70
@@ -86,6 +95,28 @@ JOINT.STABILATOR = 51
 JOINT.WING = 61
 
 
+# Body of MSG_TAG.RIG_STATE, sent on every control step.
+RIG_STATE_FORMAT = '<iHHffff'
+RigState = collections.namedtuple('RigState', [
+    'load_cell_adc_val', 'mag_feedback_adc_val', 'pot_feedback_adc_val', 'reference_deg',
+    'supply_current_a', 'supply_voltage_v', 'temperature_degc'])
+
+
+def decode_rig_state(body):
+    return RigState._make(struct.unpack(RIG_STATE_FORMAT, body))
+
+
+# Body of MSG_TAG.SIMULTANEOUS_SAMPLES: raw position and current ADC values converted at the same
+# instant, sent on every control step by firmware built with SEN_FB_ADC_DUAL_MODE.
+SIMULTANEOUS_SAMPLES_FORMAT = '<HHHH'
+SimultaneousSamples = collections.namedtuple('SimultaneousSamples', [
+    'mag_position_adc_val', 'mag_current_adc_val', 'pot_position_adc_val', 'pot_current_adc_val'])
+
+
+def decode_simultaneous_samples(body):
+    return SimultaneousSamples._make(struct.unpack(SIMULTANEOUS_SAMPLES_FORMAT, body))
+
+
 def serialize_msg(tag, body):
     serialized_msg = struct.pack('<B', tag)
     serialized_msg += body
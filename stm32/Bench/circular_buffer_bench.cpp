@@ -0,0 +1,231 @@
+// Host benchmark of CircularBuffer against the previous implementation (capacity N-1, modulo
+// indices, overwriting put), on single item and bulk transfers. Also checks that both return
+// the items in order.
+//
+// Not part of the firmware, build and run from the stm32 folder with:
+//   g++ -O2 -std=gnu++17 -IUtil/Inc Bench/circular_buffer_bench.cpp -o circular_buffer_bench
+//   ./circular_buffer_bench
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "CircularBuffer.hh"
+
+namespace legacy
+{
+
+// CircularBuffer before the SPSC rewrite, as it was.
+template<class T, size_t N> class CircularBuffer
+{
+
+  private:
+    T      buf_[N];
+    size_t head_ = 0;
+    size_t tail_ = 0;
+
+  public:
+    void put(T item)
+    {
+      buf_[head_] = item;
+
+      if (full())
+      {
+        tail_ = (tail_ + 1) % N;
+      }
+
+      head_ = (head_ + 1) % N;
+    }
+
+    uint8_t put_bulk(T *items, size_t item_size)
+    {
+      uint8_t buf_overflow = 0;
+
+      size_t size_head  = math::min(math::min(item_size, N - head_), capacity());
+      size_t size_begin = math::min(capacity() - size_head, item_size - size_head);
+
+      memcpy((void *)&buf_[head_], (void *)items, size_head);
+
+      if (size_begin > 0)
+      {
+        memcpy((void *)&buf_[0], (void *)&items[size_head], size_begin);
+      }
+
+      if (size_head == N - head_)
+      {
+        buf_overflow = 1;
+      }
+
+      size_t prev_head = head_;
+
+      head_ = (head_ + size_head + size_begin) % N;
+
+      if ((tail_ > prev_head && (tail_ <= head_ || buf_overflow)) || (tail_ <= head_ && buf_overflow))
+      {
+        tail_ = (head_ + 1) % N;
+      }
+
+      return size_head + size_begin;
+    }
+
+    T get()
+    {
+      if (empty())
+      {
+        return T();
+      }
+
+      const T data = buf_[tail_];
+      tail_        = (tail_ + 1) % N;
+
+      return data;
+    }
+
+    size_t get_bulk(T *items, size_t item_size)
+    {
+      const size_t buf_size = size();
+
+      size_t size_tail  = math::min(math::min(item_size, N - tail_), buf_size);
+      size_t size_begin = math::min(buf_size - size_tail, item_size - size_tail);
+
+      memcpy((void *)items, (void *)&buf_[tail_], size_tail);
+
+      if (size_begin > 0)
+      {
+        memcpy((void *)&items[size_tail], (void *)buf_, size_begin);
+      }
+
+      tail_ = (tail_ + size_tail + size_begin) % N;
+
+      return size_tail + size_begin;
+    }
+
+    bool empty() const
+    {
+      return (head_ == tail_);
+    }
+
+    bool full() const
+    {
+      return ((head_ + 1) % N) == tail_;
+    }
+
+    size_t capacity() const
+    {
+      return N - 1;
+    }
+
+    size_t size() const
+    {
+      return head_ >= tail_ ? head_ - tail_ : N + head_ - tail_;
+    }
+};
+
+} // namespace legacy
+
+// Same size as the UART transmit rings.
+constexpr size_t BufSize    = 1024;
+constexpr size_t Iterations = 2000000;
+constexpr size_t BulkSize   = 64;
+
+// Defeats dead code elimination of the reads.
+static volatile uint8_t sink;
+
+template<class F> static double ns_per_op(F f, size_t ops)
+{
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / double(ops);
+}
+
+// Puts then gets a few items at a time, as a producer and a consumer would.
+template<class Buffer> static double bench_single(Buffer &buf)
+{
+  return ns_per_op(
+      [&buf] {
+        uint8_t sum = 0;
+        for (size_t i = 0; i < Iterations; i += 8)
+        {
+          for (size_t j = 0; j < 8; ++j)
+          {
+            buf.put(uint8_t(i + j));
+          }
+          for (size_t j = 0; j < 8; ++j)
+          {
+            sum += buf.get();
+          }
+        }
+        sink = sum;
+      },
+      Iterations);
+}
+
+template<class Buffer> static double bench_bulk(Buffer &buf)
+{
+  return ns_per_op(
+      [&buf] {
+        uint8_t in[BulkSize] = {};
+        uint8_t out[BulkSize];
+        for (size_t i = 0; i < Iterations / BulkSize; ++i)
+        {
+          in[0] = uint8_t(i);
+          buf.put_bulk(in, BulkSize);
+          buf.get_bulk(out, BulkSize);
+          sink = out[0];
+        }
+      },
+      Iterations);
+}
+
+// Random sized bulk and single transfers, checked against a counter.
+template<class Buffer> static bool check_order(Buffer &buf)
+{
+  uint8_t next_in = 0, next_out = 0;
+  uint8_t items[BulkSize];
+
+  for (size_t i = 0; i < 100000; ++i)
+  {
+    const size_t n = size_t(rand()) % BulkSize;
+    for (size_t j = 0; j < n; ++j)
+    {
+      items[j] = next_in++;
+    }
+    buf.put_bulk(items, n);
+    buf.put(next_in++);
+
+    const size_t read = buf.get_bulk(items, size_t(rand()) % BulkSize);
+    for (size_t j = 0; j < read; ++j)
+    {
+      if (items[j] != next_out++)
+      {
+        return false;
+      }
+    }
+    while (!buf.empty())
+    {
+      if (buf.get() != next_out++)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+int main()
+{
+  static legacy::CircularBuffer<uint8_t, BufSize> legacy_buf;
+  static CircularBuffer<uint8_t, BufSize>         buf;
+
+  printf("order: legacy %s, current %s\n", check_order(legacy_buf) ? "ok" : "FAILED",
+         check_order(buf) ? "ok" : "FAILED");
+
+  printf("%-10s %12s %12s\n", "ns/byte", "legacy", "current");
+  printf("%-10s %12.2f %12.2f\n", "put/get", bench_single(legacy_buf), bench_single(buf));
+  printf("%-10s %12.2f %12.2f\n", "bulk", bench_bulk(legacy_buf), bench_bulk(buf));
+
+  return 0;
+}
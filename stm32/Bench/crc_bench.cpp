@@ -0,0 +1,165 @@
+// Host benchmark and equivalence check of the CRC16 backends of Util/Src/CRC.cpp.
+//
+// Compares, on random buffers split in random chunks as FrameEncoder feeds them:
+// - the previous 16-entry nibble table,
+// - the 256-entry byte table (crc_update_table(), the host and fallback backend),
+// - a bit-level model of the CRC peripheral fed as crc_update() does on the target with
+//   CRC_HW_BACKEND: INIT reloaded with the running value, byte-swapped words, then bytes.
+// The values are also checked against a plain bitwise CRC, the definition crcmod implements.
+// The peripheral itself only runs on the target, its model is checked but not timed.
+//
+// Not part of the firmware, build and run from the stm32 folder with:
+//   g++ -O2 -std=gnu++17 -IUtil/Inc Bench/crc_bench.cpp Util/Src/CRC.cpp -o crc_bench
+//   ./crc_bench
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#include "CRC.hh"
+
+static constexpr crc_t Poly = 0x011b;
+
+// Previous implementation, 4 bits per lookup.
+static crc_t crc_update_nibble(crc_t crc, const void *data, size_t data_len)
+{
+  static const crc_t crc_table[16] = {0x0000, 0x011b, 0x0236, 0x032d, 0x046c, 0x0577, 0x065a, 0x0741,
+                                      0x08d8, 0x09c3, 0x0aee, 0x0bf5, 0x0cb4, 0x0daf, 0x0e82, 0x0f99};
+  const unsigned char *d = (const unsigned char *)data;
+  unsigned int         tbl_idx;
+
+  while (data_len--)
+  {
+    tbl_idx = (crc >> 12) ^ (*d >> 4);
+    crc     = crc_table[tbl_idx & 0x0f] ^ (crc << 4);
+    tbl_idx = (crc >> 12) ^ (*d >> 0);
+    crc     = crc_table[tbl_idx & 0x0f] ^ (crc << 4);
+    d++;
+  }
+  return crc & 0xffff;
+}
+
+// Reference: one bit at a time, most significant bit first.
+static crc_t crc_bits(crc_t crc, uint32_t value, int bits)
+{
+  for (int i = bits - 1; i >= 0; --i)
+  {
+    const bool msb = ((crc >> 15) ^ (value >> i)) & 1;
+    crc            = ((crc << 1) ^ (msb ? Poly : 0)) & 0xffff;
+  }
+  return crc;
+}
+
+static crc_t crc_update_bitwise(crc_t crc, const void *data, size_t data_len)
+{
+  const unsigned char *d = (const unsigned char *)data;
+
+  while (data_len--)
+  {
+    crc = crc_bits(crc, *d++, 8);
+  }
+  return crc;
+}
+
+// The peripheral without input reversal processes a 32-bit write from its most significant
+// bit, so crc_update() writes the words byte-swapped (__REV) to keep the byte order.
+static crc_t crc_update_hw_model(crc_t crc, const void *data, size_t data_len)
+{
+  const unsigned char *d = (const unsigned char *)data;
+
+  for (; data_len >= 4; data_len -= 4, d += 4)
+  {
+    uint32_t word;
+    memcpy(&word, d, sizeof(word));
+    crc = crc_bits(crc, __builtin_bswap32(word), 32);
+  }
+  while (data_len--)
+  {
+    crc = crc_bits(crc, *d++, 8);
+  }
+  return crc;
+}
+
+typedef crc_t (*CrcUpdate)(crc_t, const void *, size_t);
+
+// Feeds a buffer in random chunks, as FrameEncoder does field by field.
+static crc_t crc_chunked(CrcUpdate update, const uint8_t *data, size_t len, unsigned seed)
+{
+  crc_t crc = crc_init();
+
+  srand(seed);
+  for (size_t pos = 0; pos < len;)
+  {
+    const size_t chunk = 1 + size_t(rand()) % (len - pos);
+    crc                = update(crc, data + pos, chunk);
+    pos += chunk;
+  }
+  return crc_finalize(crc);
+}
+
+static double ns_per_byte(CrcUpdate update, const uint8_t *data, size_t len, size_t iterations)
+{
+  volatile crc_t sink;
+  crc_t          crc = crc_init();
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i)
+  {
+    crc = update(crc, data, len);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  sink           = crc;
+  (void)sink;
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / double(iterations * len);
+}
+
+int main()
+{
+  static const struct
+  {
+    const char *name;
+    CrcUpdate   update;
+  } backends[] = {
+      {"nibble", crc_update_nibble},
+      {"table256", crc_update_table},
+      {"hw model", crc_update_hw_model},
+  };
+
+  // Same check value as crcmod.mkCrcFun(0x1011B, initCrc=0, rev=False)(b'123456789')
+  printf("check \"123456789\": 0x%04x\n", unsigned(crc_update_bitwise(crc_init(), "123456789", 9)));
+
+  uint8_t buf[300];
+  size_t  mismatches[3] = {};
+  for (unsigned n = 0; n < 20000; ++n)
+  {
+    srand(n);
+    const size_t len = size_t(rand()) % sizeof(buf);
+    for (size_t i = 0; i < len; ++i)
+    {
+      buf[i] = uint8_t(rand());
+    }
+
+    const crc_t expected = crc_update_bitwise(crc_init(), buf, len);
+    for (size_t b = 0; b < 3; ++b)
+    {
+      mismatches[b] += crc_chunked(backends[b].update, buf, len, n) != expected;
+    }
+  }
+  for (size_t b = 0; b < 3; ++b)
+  {
+    printf("%-9s %zu mismatches over 20000 buffers\n", backends[b].name, mismatches[b]);
+  }
+
+  // Typical telemetry message sizes, and a full one
+  for (size_t len : {8, 32, 256})
+  {
+    printf("%3zu bytes: nibble %.2f ns/byte, table256 %.2f ns/byte\n", len,
+           ns_per_byte(crc_update_nibble, buf, len, 20000000 / len),
+           ns_per_byte(crc_update_table, buf, len, 20000000 / len));
+  }
+
+  return 0;
+}
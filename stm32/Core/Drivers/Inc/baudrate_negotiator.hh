@@ -0,0 +1,85 @@
+/**
+ * @file    baudrate_negotiator.hh
+ * @brief   Runtime baud rate switch of the telemetry link.
+ *
+ * The link starts at SERIAL_BOOT_BAUDRATE. The host requests a higher rate with
+ * CMD_SERIAL_SET_BAUDRATE, the device switches at the end of the message being
+ * sent, without waiting in the control step. The host then reopens its port at the new rate and, once it
+ * receives valid telemetry, confirms by repeating the request (on the command
+ * port, which is the same port unless SERIAL_SPLIT_PORTS). Without a
+ * confirmation within SERIAL_BAUDRATE_CONFIRM_MS the device falls back to the
+ * boot rate, so a host that didn't follow the switch can always reconnect.
+ */
+
+#pragma once
+
+#include "main.h"
+#include "uart_driver.hh"
+
+#define SERIAL_BAUDRATE_MIN 				9600U
+#define SERIAL_BAUDRATE_MAX 				2000000U
+
+/** Time given to the host to reopen its port and confirm the new rate. */
+#define SERIAL_BAUDRATE_CONFIRM_MS 	1000U
+
+class BaudrateNegotiator
+{
+private:
+	UartDriver *_uart;
+	uint32_t _boot_baudrate;
+
+	// 1 while the new rate hasn't been confirmed by the host
+	uint8_t _confirming = 0;
+	uint32_t _switch_ms = 0;
+
+public:
+	BaudrateNegotiator(UartDriver *uart, uint32_t boot_baudrate) :
+			_uart(uart), _boot_baudrate(boot_baudrate)
+	{
+	}
+
+	/**
+	 * @brief Handles a baud rate request of the host.
+	 *
+	 * @return uint8_t 1 if the rate is supported, 0 otherwise.
+	 */
+	uint8_t request(uint32_t baudrate)
+	{
+		if(baudrate < SERIAL_BAUDRATE_MIN || baudrate > SERIAL_BAUDRATE_MAX)
+		{
+			return 0;
+		}
+
+		if(baudrate == _uart->get_baudrate())
+		{
+			// Already running at this rate, the request confirms it
+			_confirming = 0;
+			return 1;
+		}
+
+		_uart->set_baudrate(baudrate);
+
+		_confirming = baudrate != _boot_baudrate;
+		_switch_ms = HAL_GetTick();
+
+		return 1;
+	}
+
+	// Called periodically, completes a switch deferred until the end of the message being sent
+	// and falls back to the boot rate if the switch wasn't confirmed
+	void update(void)
+	{
+		_uart->update();
+
+		if(_confirming && HAL_GetTick() - _switch_ms > SERIAL_BAUDRATE_CONFIRM_MS)
+		{
+			_confirming = 0;
+			_uart->set_baudrate(_boot_baudrate);
+		}
+	}
+
+	uint32_t get_baudrate(void) const
+	{
+		return _uart->get_baudrate();
+	}
+};
@@ -0,0 +1,199 @@
+/**
+ * @file    current_profile_sampler.hh
+ * @brief   Servo supply current sampling synchronised with the servo PWM frame.
+ *
+ * The servo draws current in step with its own 50 Hz command pulse, so a
+ * sample taken at an arbitrary point of the frame is mostly noise. This driver
+ * uses a spare compare channel of the servo PWM timer (output-compare timing
+ * mode, no pin) to trigger an ADC injected conversion of the current channel
+ * at a list of configurable offsets within each PWM frame.
+ *
+ * After every injected conversion the compare register is moved to the next
+ * offset, so a full phase-resolved profile is collected each frame without
+ * raising the regular scan rate. Completed frames are double-buffered and can
+ * be fetched from the main loop.
+ */
+
+#pragma once
+
+#include "main.h"
+#include <string.h>
+
+/** Max number of sampling points within one PWM frame. */
+#define CUR_PROFILE_MAX_POINTS 	8U
+
+/** Minimum spacing between two sampling points, leaves time for conversion and ISR. */
+#define CUR_PROFILE_MIN_SPACING_US 	50U
+
+typedef struct
+{
+	uint32_t frame;															/*!< PWM frame counter */
+	uint8_t n_points;														/*!< number of valid points */
+	uint16_t offset_us[CUR_PROFILE_MAX_POINTS];	/*!< sampling offsets from frame start */
+	uint16_t adc_val[CUR_PROFILE_MAX_POINTS];		/*!< raw current ADC values */
+} CurrentProfile_t;
+
+class CurrentProfileSampler
+{
+private:
+	ADC_HandleTypeDef *_hadcx;
+	uint32_t _adc_channel;
+	TIM_HandleTypeDef *_htimx;
+	uint32_t _timx_channel;
+
+	// Sampling points
+	uint16_t _offsets_us[CUR_PROFILE_MAX_POINTS] = {100, 500, 1000, 1500, 2000, 2500, 5000, 10000};
+	uint8_t _n_points = CUR_PROFILE_MAX_POINTS;
+	volatile uint8_t _index = 0;
+
+	// Profile being filled by the ISR and last completed profile
+	CurrentProfile_t _filling = {};
+	CurrentProfile_t _ready = {};
+	volatile uint8_t _ready_available = 0;
+	uint32_t _frame = 0;
+
+public:
+	CurrentProfileSampler(ADC_HandleTypeDef *hadcx, uint32_t adc_channel,
+												TIM_HandleTypeDef *htimx, uint32_t timx_channel) :
+			_hadcx(hadcx), _adc_channel(adc_channel), _htimx(htimx), _timx_channel(timx_channel)
+	{
+	}
+
+	uint8_t init(void)
+	{
+		ADC_InjectionConfTypeDef sConfigInjected = {0};
+		TIM_OC_InitTypeDef sConfigOC = {0};
+
+		// Current channel on the injected group, triggered by the PWM timer compare event
+		sConfigInjected.InjectedChannel = _adc_channel;
+		sConfigInjected.InjectedRank = ADC_INJECTED_RANK_1;
+		sConfigInjected.InjectedSamplingTime = ADC_SAMPLETIME_92CYCLES_5;
+		sConfigInjected.InjectedSingleDiff = ADC_SINGLE_ENDED;
+		sConfigInjected.InjectedOffsetNumber = ADC_OFFSET_NONE;
+		sConfigInjected.InjectedOffset = 0;
+		sConfigInjected.InjectedNbrOfConversion = 1;
+		sConfigInjected.InjectedDiscontinuousConvMode = DISABLE;
+		sConfigInjected.AutoInjectedConv = DISABLE;
+		sConfigInjected.QueueInjectedContext = DISABLE;
+		sConfigInjected.ExternalTrigInjecConv = ADC_EXTERNALTRIGINJEC_T2_CC1;
+		sConfigInjected.ExternalTrigInjecConvEdge = ADC_EXTERNALTRIGINJECCONV_EDGE_RISING;
+		sConfigInjected.InjecOversamplingMode = DISABLE;
+		if(HAL_ADCEx_InjectedConfigChannel(_hadcx, &sConfigInjected) != HAL_OK)
+		{
+			return 0;
+		}
+
+		// Compare channel without output, only used as trigger source
+		sConfigOC.OCMode = TIM_OCMODE_TIMING;
+		sConfigOC.Pulse = us_to_ticks(_offsets_us[0]);
+		sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+		sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+		if(HAL_TIM_OC_ConfigChannel(_htimx, &sConfigOC, _timx_channel) != HAL_OK)
+		{
+			return 0;
+		}
+
+		_index = 0;
+
+		if(HAL_ADCEx_InjectedStart_IT(_hadcx) != HAL_OK)
+		{
+			return 0;
+		}
+		return (HAL_TIM_OC_Start(_htimx, _timx_channel) == HAL_OK);
+	}
+
+	/**
+	 * @brief Sets the sampling offsets within the PWM frame.
+	 *
+	 * The new offsets take effect at the next compare match, so the first
+	 * profile after a change may only cover part of a frame.
+	 *
+	 * @param offsets_us Offsets from the frame start in µs, strictly ascending.
+	 * @param n_points Number of offsets, at most CUR_PROFILE_MAX_POINTS.
+	 * @return uint8_t 1 if the offsets were accepted, 0 otherwise.
+	 */
+	uint8_t set_offsets(const uint16_t *offsets_us, uint8_t n_points)
+	{
+		const uint32_t period_us = (__HAL_TIM_GET_AUTORELOAD(_htimx) + 1) * (_htimx->Init.Prescaler + 1)
+				/ (TIM_CLK_FREQ_HZ / 1000000);
+
+		if(n_points == 0 || n_points > CUR_PROFILE_MAX_POINTS)
+		{
+			return 0;
+		}
+
+		for(uint8_t i = 0; i < n_points; i++)
+		{
+			if(offsets_us[i] >= period_us
+					|| (i > 0 && offsets_us[i] < offsets_us[i - 1] + CUR_PROFILE_MIN_SPACING_US))
+			{
+				return 0;
+			}
+		}
+
+		HAL_NVIC_DisableIRQ(ADC1_2_IRQn);
+		memcpy(_offsets_us, offsets_us, n_points * sizeof(uint16_t));
+		_n_points = n_points;
+		_index = 0;
+		_filling.n_points = 0;
+		__HAL_TIM_SET_COMPARE(_htimx, _timx_channel, us_to_ticks(_offsets_us[0]));
+		HAL_NVIC_EnableIRQ(ADC1_2_IRQn);
+
+		return 1;
+	}
+
+	/**
+	 * @brief Copies the last completed frame profile.
+	 *
+	 * @param profile Destination of the profile.
+	 * @return uint8_t 1 if a new profile was available since the last call, 0 otherwise.
+	 */
+	uint8_t get_profile(CurrentProfile_t *profile)
+	{
+		if(!_ready_available)
+		{
+			return 0;
+		}
+
+		HAL_NVIC_DisableIRQ(ADC1_2_IRQn);
+		*profile = _ready;
+		_ready_available = 0;
+		HAL_NVIC_EnableIRQ(ADC1_2_IRQn);
+
+		return 1;
+	}
+
+	ADC_TypeDef* get_adc_instance(void)
+	{
+		return _hadcx->Instance;
+	}
+
+	// Called from the ADC injected end of conversion interrupt
+	void on_injected_conv_cplt(void)
+	{
+		uint8_t i = _index;
+
+		_filling.offset_us[i] = _offsets_us[i];
+		_filling.adc_val[i] = (uint16_t)HAL_ADCEx_InjectedGetValue(_hadcx, ADC_INJECTED_RANK_1);
+
+		if(++i >= _n_points)
+		{
+			// Frame complete
+			_filling.frame = _frame++;
+			_filling.n_points = _n_points;
+			_ready = _filling;
+			_ready_available = 1;
+			i = 0;
+		}
+
+		// Arm the trigger for the next sampling point
+		_index = i;
+		__HAL_TIM_SET_COMPARE(_htimx, _timx_channel, us_to_ticks(_offsets_us[i]));
+	}
+
+private:
+	uint32_t us_to_ticks(uint16_t us)
+	{
+		return (uint32_t)us * (TIM_CLK_FREQ_HZ / 1000000) / (_htimx->Init.Prescaler + 1);
+	}
+};
@@ -29,6 +29,15 @@
 /* DS18B20 read temperature command */
 #define DS18B20_CMD_CONVERTTEMP		0x44 	/* Convert temperature */
 
+/* Scratchpad layout ------------------------------------------------------- */
+
+#define DS18B20_SCRATCHPAD_SIZE		9		/* Including the CRC byte */
+#define DS18B20_SCRATCHPAD_CONFIG	4		/* Configuration register, holds the resolution */
+#define DS18B20_SCRATCHPAD_CRC		8
+
+/* Max temperature conversion time at 12 bits resolution, halved for each bit less */
+#define DS18B20_CONV_TIME_12BIT_MS	750U
+
 /** All ROM addresses of the ds18b20 sensors currently in the company's possession.
  * (i.e. to be placed on the bus.)
  */
@@ -32,6 +32,24 @@ typedef struct
 	uint16_t sensor_id;
 } TemperatureMsg_t;
 
+#if ONE_WIRE_UART_TRANSPORT || ONE_WIRE_TIMER_TRANSPORT
+/** Number of scratchpad bytes read per call to update(), read in the background by DMA. */
+#define DS18B20_READ_BYTES_PER_UPDATE	DS18B20_SCRATCHPAD_SIZE
+#else
+/** Number of scratchpad bytes read per call to update(), ~0.5ms each with the GPIO bus. */
+#define DS18B20_READ_BYTES_PER_UPDATE	3U
+#endif
+
+typedef enum
+{
+	DS18B20_STATE_SCAN = 0,					/*!< starting a search of all sensors on the bus */
+	DS18B20_STATE_SEARCH,						/*!< searching the bus in the background, one device per search */
+	DS18B20_STATE_IDLE,							/*!< no conversion in progress */
+	DS18B20_STATE_CONVERTING,				/*!< waiting for the conversion time to elapse */
+	DS18B20_STATE_SELECT,						/*!< addressing the next sensor to read */
+	DS18B20_STATE_READING						/*!< reading the scratchpad */
+} DS18B20State_t;
+
 
 class DS18B20Driver {
 
@@ -40,6 +58,23 @@ class DS18B20Driver {
     TemperatureMsg_t 	_temperatures[ONE_WIRE_SENSORS_MAX];
     uint8_t _device_count = 0;
 
+    // Cached ROM table, filled by the background search
+    uint8_t _roms[ONE_WIRE_SENSORS_MAX][8];
+    uint8_t _scan_count = 0;
+    uint8_t _rescan = 0;
+
+    // Asynchronous conversion and read of all sensors
+    DS18B20State_t _state = DS18B20_STATE_SCAN;
+    uint8_t _resolution = 12;
+    uint8_t _max_resolution = 0;
+    uint32_t _conv_start_ms = 0;
+    uint8_t _sensor_idx = 0;
+    uint8_t _scratchpad[DS18B20_SCRATCHPAD_SIZE];
+    uint8_t _scratchpad_idx = 0;
+    uint8_t _scratchpad_pending = 0;
+    uint16_t _updated = 0;
+    uint32_t _crc_errors = 0;
+
   public: DS18B20Driver(OneWireDriver *bus) : _bus(bus) {}
 
   private:
@@ -64,6 +99,29 @@ class DS18B20Driver {
     //
     void start_all();
 
+    // SCRATCHPAD_TO_TEMPERATURE - converts the temperature register of a scratchpad to °C
+    // using the resolution stored in its configuration register.
+    //
+    float scratchpad_to_temperature(uint8_t *data);
+
+    // CONVERSION_TIME_MS - max conversion time at the highest resolution of the sensors
+    //
+    uint32_t conversion_time_ms();
+
+    // SEARCH_STEP - adds the sensor found by the completed search to the ROM table,
+    // returns 0 once the scan is complete.
+    //
+    uint8_t search_step();
+
+    // READ_COMPLETE - checks and records the scratchpad of the sensor being read.
+    //
+    void read_complete();
+
+    // NEXT_SENSOR - moves to the next sensor to read, or rescans the bus at the end of a
+    // cycle with a missed or CRC-failed read.
+    //
+    void next_sensor();
+
   public:
     /**
      * Reads the temperature from the one-wire bus if only one sensor is on the bus.
@@ -72,6 +130,32 @@ class DS18B20Driver {
      */
     float read_temperature_single();
 
+    /**
+     * @brief Advances the background scan of all sensors on the bus, without blocking.
+     *
+     * The bus is searched once in the background, one device per search, and the ROM
+     * codes and ids are cached. It is only searched again after a cycle with a missed
+     * or CRC-failed read (a sensor unplugged), or when a sensor is plugged in: its
+     * power-up presence pulse on the idle bus, or any presence pulse while no sensor
+     * is known. A reset presence pulse alone cannot tell, the other sensors answer it.
+     *
+     * A broadcast conversion is then started, and once the resolution-dependent
+     * conversion time has elapsed each sensor is selected by its ROM and its
+     * scratchpad read a few bytes per call. Transfers run in the background when
+     * the bus transport supports it. A result is only accepted if the scratchpad
+     * CRC matches. Call once per tick.
+     */
+    void update();
+
+    /**
+     * @brief Returns the sensors converted by update() since the last call.
+     *
+     * @return uint16_t Bit i is set if get_temperature(i) has been updated.
+     */
+    uint16_t get_updated();
+
+    uint32_t get_crc_errors();
+
     /**
      * @brief Reads the temperature from the one-write bus if multiple sensors are attached.
      * 
@@ -11,6 +11,9 @@
 #include "sensor_feedback_driver.hh"
 #include "servo_p500_driver.hh"
 #include "serial_interface.hh"
+#include "baudrate_negotiator.hh"
+#include "test_plan.hh"
+#include "param_server.hh"
 #include "Telemetry.hh"
 #include "IntervalWaiter.hh"
 #include "math.h"
@@ -22,6 +25,20 @@
 #define SERVO_CTRL_WF_MAX_PERIOD_S 20.0
 #define SERVO_CTRL_WF_MAX_LEN 1000
 
+// Commands handled per step at most: a full queue and the scheduled commands falling due
+#define SERVO_CTRL_MAX_CMDS_PER_STEP (SI_CMD_QUEUE_SIZE + SI_CMD_SCHEDULE_SIZE)
+
+// Acknowledgement of a command, sent once its effect has been applied to the servo
+typedef struct
+{
+	uint16_t sequence;
+	SiCmd_t command;
+	SiCmdStatus_t status;
+	uint32_t received_us;
+} PendingAck_t;
+
+static_assert(CUR_PROFILE_MAX_POINTS == telem::CURRENT_PROFILE_POINTS_MAX, "Current profile size mismatch");
+
 typedef struct
 {
 	// Values
@@ -55,22 +72,35 @@ private:
 	dfr::IntervalWaiter _interval_waiter;
 	ServoP500Driver *_servo;
 	SensorFeedbackDriver *_sensors;
-	SerialInterface *_host_pc;
+	SerialInterface _host_pc;
+	BaudrateNegotiator *_telem_link;
 	telem::SerialWriter _telem;
+	telem::SerialWriter _acks;
+	PendingAck_t _pending_acks[SERVO_CTRL_MAX_CMDS_PER_STEP];
+	size_t _nb_pending_acks = 0;
 	Sinusoid_t _waveform;
+	TestPlan _plan;
+	ParamServer *_params;
 	float _reference_deg;
+	uint32_t _log_count = 0;
 
 public:
 	ServoController(TimeSourceInterface *time_source,
 									ServoP500Driver *servo,
 									SensorFeedbackDriver *sensors,
-									SerialInterface *host_pc,
-									StreamInterface *stream_telem) :
+									StreamInterface *stream_cmd,
+									BaudrateNegotiator *telem_link,
+									StreamInterface *stream_telem,
+									ParamServer *params) :
+									_time_source(time_source),
 									_interval_waiter(time_source, SERVO_CTRL_LOOP_PER_US),
 									_servo(servo),
 									_sensors(sensors),
-									_host_pc(host_pc),
-									_telem(stream_telem)
+									_host_pc(stream_cmd, time_source),
+									_telem_link(telem_link),
+									_telem(stream_telem),
+									_acks(stream_cmd),
+									_params(params)
 	{
 	}
 
@@ -180,77 +210,367 @@ public:
 		return 1;
 	}*/
 
-	void step(void)
+	SiCmdStatus_t on_serial_set_baudrate(const SiSetBaudrate_t &cmd)
 	{
-		// Wait for next step
-	  while (!_interval_waiter.next_interval())
-	  {
-	  }
+		return _telem_link->request(cmd.baudrate) ? CMD_STATUS_OK : CMD_STATUS_REJECTED;
+	}
 
-	  HAL_GPIO_WritePin(GPIOC, GPIO_PIN_10, GPIO_PIN_SET);
+	SiCmdStatus_t on_servo_stop(const SiNoPayload_t &)
+	{
+		// An immediate stop also cancels the scheduled commands
+		if(!_host_pc.is_scheduled())
+		{
+			_host_pc.clear_schedule();
+		}
+		abort_plan();
+		stop_waveform();
+		return CMD_STATUS_OK;
+	}
 
-		// Read sensors
-		_sensors->update();
+	SiCmdStatus_t on_servo_set_angle(const SiSetAngle_t &cmd)
+	{
+		abort_plan();
+		stop_waveform();
+		_reference_deg = cmd.angle_deg;
+		return CMD_STATUS_OK;
+	}
 
-		// Read user commands
-		SiCmd_t cmd_code = _host_pc->read();
+	SiCmdStatus_t on_servo_start_sin(const SiSinusoid_t &cmd)
+	{
+		abort_plan();
+		return start_sinusoid(cmd);
+	}
 
-		// Update state
-		if(cmd_code == CMD_NO_CMD)
+	SiCmdStatus_t on_servo_start_sin_sweep(const SiSinusoidSweep_t &cmd)
+	{
+		abort_plan();
+		return start_sweep(cmd);
+	}
+
+	SiCmdStatus_t start_sinusoid(const SiSinusoid_t &cmd)
+	{
+		_waveform.angle_min_deg = cmd.angle_min_deg;
+		_waveform.angle_max_deg = cmd.angle_max_deg;
+		_waveform.period_s = cmd.period_s;
+		uint8_t valid = create_waveform_sinusoidal(_waveform.angle_min_deg, _waveform.angle_max_deg, _waveform.period_s);
+		_waveform.enabled = valid != 0;
+		_waveform.sweep_enabled = false;
+		restart_waveform();
+		return valid ? CMD_STATUS_OK : CMD_STATUS_REJECTED;
+	}
+
+	SiCmdStatus_t start_sweep(const SiSinusoidSweep_t &cmd)
+	{
+		_waveform.angle_min_deg = cmd.angle_min_deg;
+		_waveform.angle_max_deg = cmd.angle_max_deg;
+		_waveform.period_min_s = cmd.period_min_s;
+		_waveform.period_max_s = cmd.period_max_s;
+		_waveform.n_periods = cmd.n_periods;
+		_waveform.n_cycles_per_period = cmd.n_cycles_per_period;
+		if(_waveform.period_max_s > _waveform.period_min_s && _waveform.n_periods > 0
+				&& _waveform.period_min_s >= SERVO_CTRL_WF_MIN_PERIOD_S)
 		{
+			_waveform.period_s = _waveform.period_max_s;
+			uint8_t valid = create_waveform_sinusoidal(_waveform.angle_min_deg, _waveform.angle_max_deg, _waveform.period_s);
+			_waveform.enabled = valid != 0;
+			_waveform.sweep_enabled = valid != 0;
+			restart_waveform();
+			return valid ? CMD_STATUS_OK : CMD_STATUS_REJECTED;
 		}
-		else if(cmd_code == CMD_SERVO_STOP)
+		return CMD_STATUS_REJECTED;
+	}
+
+	// Plays a new waveform table from its start, and counts the cycles of a sweep from zero
+	void restart_waveform(void)
+	{
+		_waveform.head = 0;
+		_waveform.cycles_count = 0;
+		_waveform.periods_count = 0;
+	}
+
+	// Acknowledged with the time the device received it, lets the host map its time to the
+	// device time for scheduled commands
+	SiCmdStatus_t on_serial_ping(const SiNoPayload_t &)
+	{
+		return CMD_STATUS_OK;
+	}
+
+	SiCmdStatus_t on_plan_clear(const SiNoPayload_t &)
+	{
+		abort_plan();
+		_plan.clear();
+		return CMD_STATUS_OK;
+	}
+
+	SiCmdStatus_t on_plan_add_step(const SiPlanStep_t &cmd)
+	{
+		return _plan.add_step(cmd) ? CMD_STATUS_OK : CMD_STATUS_REJECTED;
+	}
+
+	SiCmdStatus_t on_plan_start(const SiNoPayload_t &)
+	{
+		abort_plan();
+		if(!_plan.start())
 		{
-			stop_waveform();
+			return CMD_STATUS_REJECTED;
 		}
-		else if(cmd_code == CMD_SERVO_SET_ANGLE)
+		log_plan_event(telem::TEST_PLAN_EVENT_STARTED);
+		start_plan_step();
+		return CMD_STATUS_OK;
+	}
+
+	SiCmdStatus_t on_param_get(const SiParamId_t &cmd)
+	{
+		return send_param(cmd.id) ? CMD_STATUS_OK : CMD_STATUS_REJECTED;
+	}
+
+	SiCmdStatus_t on_param_set(const SiParamSet_t &cmd)
+	{
+		if(!_params->set(cmd.id, cmd.value))
+		{
+			return CMD_STATUS_REJECTED;
+		}
+		send_param(cmd.id);
+		return CMD_STATUS_OK;
+	}
+
+	SiCmdStatus_t on_param_list(const SiNoPayload_t &)
+	{
+		for(uint8_t id = 0; id < PARAM_ID_MAX; id++)
+		{
+			send_param(id);
+		}
+		return CMD_STATUS_OK;
+	}
+
+	SiCmdStatus_t on_param_save(const SiNoPayload_t &)
+	{
+#if PARAM_FLASH_PERSISTENCE
+		return _params->save() ? CMD_STATUS_OK : CMD_STATUS_REJECTED;
+#else
+		return CMD_STATUS_UNSUPPORTED;
+#endif
+	}
+
+	SiCmdStatus_t on_param_reset(const SiNoPayload_t &)
+	{
+		_params->reset();
+		return CMD_STATUS_OK;
+	}
+
+	SiCmdStatus_t on_current_profile_offsets(const SiCurrentProfileOffsets_t &cmd)
+	{
+		static_assert(CUR_PROFILE_MAX_POINTS == 8, "One payload field per sampling point");
+		const uint16_t offsets_us[CUR_PROFILE_MAX_POINTS] = {cmd.offset_0_us, cmd.offset_1_us, cmd.offset_2_us,
+																												 cmd.offset_3_us, cmd.offset_4_us, cmd.offset_5_us,
+																												 cmd.offset_6_us, cmd.offset_7_us};
+
+		return _sensors->set_current_profile_offsets(offsets_us, cmd.n_points) ? CMD_STATUS_OK : CMD_STATUS_REJECTED;
+	}
+
+	// Answers a parameter request on the command port, returns 0 if the id is unknown
+	uint8_t send_param(uint8_t id)
+	{
+		ParamInfo_t info;
+		if(!_params->get_info(id, &info))
 		{
-			stop_waveform();
-			float angle_deg = 0;
-			_host_pc->get_target_angle(&angle_deg);
-			_reference_deg = angle_deg;
+			return 0;
 		}
-		else if(cmd_code == CMD_SERVO_START_SIN)
+		_acks.write_message(telem::MSG_TAG_PARAM_VALUE,
+												telem::param_value_msg{info.id, info.type, info.value, info.min, info.max, info.default_value});
+		return 1;
+	}
+
+	void abort_plan(void)
+	{
+		if(_plan.is_running())
 		{
-			_host_pc->get_sin_params(&_waveform.angle_min_deg, &_waveform.angle_max_deg, &_waveform.period_s);
-			create_waveform_sinusoidal(_waveform.angle_min_deg, _waveform.angle_max_deg, _waveform.period_s);
-			_waveform.enabled = true;
-			_waveform.sweep_enabled = false;
+			_plan.abort();
+			log_plan_event(telem::TEST_PLAN_EVENT_ABORTED);
 		}
-		/**else if(cmd_code == CMD_SERVO_START_TRAP)
+	}
+
+	// Starts the current step of the test plan, aborts the plan if its parameters are invalid
+	void start_plan_step(void)
+	{
+		const SiPlanStep_t &step = _plan.get_step();
+		SiCmdStatus_t status = CMD_STATUS_OK;
+
+		log_plan_event(telem::TEST_PLAN_EVENT_STEP);
+
+		switch(step.type)
 		{
-			float angle_min_deg = 0;
-			float angle_max_deg = 0;
-			float period_s = 0;
-			float plateau_time_s = 0;
-			_host_pc->get_trap_params(&angle_min_deg, &angle_max_deg, &period_s,
-																&plateau_time_s);
-			create_waveform_trapezoidal(angle_min_deg, angle_max_deg, period_s,
-																	plateau_time_s);
-			_waveform.enabled = true;
-			_waveform.sweep_enabled = false;
-		}*/
-		else if(cmd_code == CMD_SERVO_START_SIN_SWEEP)
+			case PLAN_STEP_SET_ANGLE:
+				stop_waveform();
+				_reference_deg = step.value_0;
+				break;
+			case PLAN_STEP_SINE:
+				status = start_sinusoid(SiSinusoid_t{step.value_0, step.value_1, step.value_2});
+				break;
+			case PLAN_STEP_SWEEP:
+				status = start_sweep(SiSinusoidSweep_t{step.value_0, step.value_1, step.value_2, step.value_3,
+																							 step.count_0, step.count_1});
+				break;
+			default:
+				// Hold the current angle
+				_waveform.enabled = false;
+				break;
+		}
+
+		if(status != CMD_STATUS_OK)
 		{
-			_host_pc->get_sin_sweep_params(&_waveform.angle_min_deg,
-															       &_waveform.angle_max_deg,
-																		 &_waveform.period_min_s,
-																		 &_waveform.period_max_s,
-																		 &_waveform.n_periods,
-																		 &_waveform.n_cycles_per_period);
-			if(_waveform.period_max_s > _waveform.period_min_s && _waveform.n_periods > 0)
+			abort_plan();
+		}
+	}
+
+	// Duration of a test plan step in control steps, computed in 64 bits: duration_ms * SERVO_CTRL_LOOP_FREQ_HZ
+	// overflows 32 bits after ~24h
+	uint32_t plan_step_duration_ticks(const SiPlanStep_t &step)
+	{
+		return (uint32_t)((uint64_t)step.duration_ms * SERVO_CTRL_LOOP_FREQ_HZ / 1000);
+	}
+
+	// Returns true once the current step of the test plan is complete
+	bool plan_step_complete(void)
+	{
+		const SiPlanStep_t &step = _plan.get_step();
+
+		switch(step.type)
+		{
+			case PLAN_STEP_SINE:
+			case PLAN_STEP_HOLD:
+				return _plan.get_step_ticks() >= plan_step_duration_ticks(step);
+			case PLAN_STEP_SWEEP:
+				return !_waveform.enabled;
+			case PLAN_STEP_WAIT:
+				return plan_condition_met((PlanCondition_t)step.count_0, step.value_0);
+			default:
+				return true;
+		}
+	}
+
+	bool plan_condition_met(PlanCondition_t condition, float threshold)
+	{
+		SensorState_t state = _sensors->get_state();
+		float temperature_max = -INFINITY;
+
+		for(size_t i = 0; i < state.nb_temp_sensors; i++)
+		{
+			temperature_max = fmaxf(temperature_max, state.temperature_degc[i].temp);
+		}
+
+		switch(condition)
+		{
+			case PLAN_COND_TEMPERATURE_BELOW:
+				return state.nb_temp_sensors > 0 && temperature_max < threshold;
+			case PLAN_COND_TEMPERATURE_ABOVE:
+				return temperature_max > threshold;
+			case PLAN_COND_CURRENT_BELOW:
+				return state.supply_current_a < threshold;
+			default:
+				return false;
+		}
+	}
+
+	// Moves the test plan to its next step once the current one is complete, on a control step
+	void update_plan(void)
+	{
+		if(!_plan.is_running())
+		{
+			return;
+		}
+
+		_plan.tick();
+
+		if(plan_step_complete())
+		{
+			if(_plan.next())
+			{
+				start_plan_step();
+			}
+			else
 			{
-				_waveform.period_s = _waveform.period_max_s;
-				create_waveform_sinusoidal(_waveform.angle_min_deg, _waveform.angle_max_deg, _waveform.period_s);
-				_waveform.enabled = true;
-				_waveform.sweep_enabled = true;
+				// Hold the last angle
+				_waveform.enabled = false;
+				log_plan_event(telem::TEST_PLAN_EVENT_FINISHED);
 			}
 		}
-		/**else if(cmd_code == CMD_SERVO_START_TRAP_SWEEP)
+		else if(_plan.get_step().type == PLAN_STEP_WAIT && _plan.get_step().duration_ms > 0
+				&& _plan.get_step_ticks() >= plan_step_duration_ticks(_plan.get_step()))
+		{
+			_plan.abort();
+			log_plan_event(telem::TEST_PLAN_EVENT_TIMEOUT);
+		}
+	}
+
+	void log_plan_event(uint8_t event)
+	{
+		_telem.write_message(telem::MSG_TAG_TEST_PLAN,
+												 telem::test_plan_msg{event, _plan.get_index(), _plan.get_step().type, _plan.get_loops(),
+																							(uint32_t)_interval_waiter.get_now_micros()});
+	}
+
+	// Calls the on_<name>() handler of a command of the host (SI_COMMAND_TABLE) with its
+	// payload, returns the status to acknowledge
+	SiCmdStatus_t handle_command(SiCmd_t cmd_code)
+	{
+		switch(cmd_code)
+		{
+#define SERVO_CTRL_DISPATCH(code_enum, code, name, payload) \
+			case code_enum: \
+				return on_##name(_host_pc.get_payload<code_enum>());
+
+			SI_COMMAND_TABLE(SERVO_CTRL_DISPATCH)
+
+#undef SERVO_CTRL_DISPATCH
+			default:
+				return CMD_STATUS_UNSUPPORTED;
+		}
+	}
+
+	// Sends the acknowledgements of the commands handled in this step
+	void send_acks(uint32_t applied_us)
+	{
+		for(size_t i = 0; i < _nb_pending_acks; i++)
+		{
+			const PendingAck_t &ack = _pending_acks[i];
+			_acks.write_message(telem::MSG_TAG_PILOT_CMD_ACK,
+													telem::pilot_cmd_ack_msg{ack.sequence, (uint8_t)ack.command, (uint8_t)ack.status,
+																									 ack.received_us, applied_us});
+		}
+		_nb_pending_acks = 0;
+	}
+
+	void step(void)
+	{
+		// Wait for next step
+	  while (!_interval_waiter.next_interval())
+	  {
+	  	// Decode commands as they arrive so that their receive time is accurate
+	  	_host_pc.parse();
+	  }
+
+	  HAL_GPIO_WritePin(GPIOC, GPIO_PIN_10, GPIO_PIN_SET);
+
+		// Read sensors
+		_sensors->update();
+
+		// Test plan transitions, before the commands so that a step started by either runs for
+		// the same number of control steps
+		update_plan();
+
+		// Handle the commands received since the last step in order, and the scheduled commands
+		// due at this step. Bounded so that the step duration stays bounded.
+		SiCmd_t cmd_code;
+		while(_nb_pending_acks < SERVO_CTRL_MAX_CMDS_PER_STEP
+				&& (cmd_code = _host_pc.read(_interval_waiter.get_now_micros())) != CMD_NO_CMD)
 		{
-			_waveform.enabled = true;
-			_waveform.sweep_enabled = true;
-		}*/
+			SiCmdStatus_t status = _host_pc.schedule_full() ? CMD_STATUS_SCHEDULE_FULL : handle_command(cmd_code);
+			_pending_acks[_nb_pending_acks++] = {_host_pc.get_sequence(), cmd_code, status, _host_pc.get_received_us()};
+		}
+
+		// Falls back to the boot baud rate if a switch wasn't confirmed
+		_telem_link->update();
 
 		// Servo actions
 		if(_waveform.enabled)
@@ -289,6 +609,7 @@ public:
 
 		// Apply reference
 		_servo->set_angle(_reference_deg);
+		send_acks(_time_source->now_micros());
 
 		// Log to Grafana
 		log();
@@ -299,16 +620,80 @@ public:
 	{
 
 		SensorState_t state = _sensors->get_state();
+
+		// One frame per message, sent with a single commit to the transmit buffer
+		_telem.begin_batch();
 		_telem.write_sequence_message();
 		_telem.write_message(telem::MSG_TAG_SOURCE_ID, strlen(_source_id), _source_id);
 	  _telem.write_message(telem::MSG_TAG_TIME_LOCAL, _interval_waiter.get_now_micros());
-		_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{0, (float)state.load_cell_adc_val});
-		_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{1, (float)state.mag_feedback_adc_val});
-		_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{2, (float)state.pot_feedback_adc_val});
-		_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{3, _reference_deg});
-		_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{4, state.supply_current_a});
-		_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{5, state.supply_voltage_v});
-		_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{6, state.temperature_degc[0].temp});
+
+		_telem.write_message(telem::MSG_TAG_RIG_STATE,
+												 telem::rig_state_msg{state.load_cell_adc_val,
+																							state.mag_feedback_adc_val,
+																							state.pot_feedback_adc_val,
+																							_reference_deg,
+																							state.supply_current_a,
+																							state.supply_voltage_v,
+																							state.temperature_degc[0].temp});
+
+#if SEN_FB_ADC_DUAL_MODE
+		_telem.write_message(telem::MSG_TAG_SIMULTANEOUS_SAMPLES,
+												 telem::simultaneous_samples_msg{state.mag_sim_position_adc_val,
+																												 state.mag_sim_current_adc_val,
+																												 state.pot_feedback_adc_val,
+																												 state.pot_sim_current_adc_val});
+#endif
+
+		// Same values as floats on separate debug channels, enabled by PARAM_TELEM_DEBUG_CHANNELS
+		const float debug_values[] = {(float)state.load_cell_adc_val,
+																	(float)state.mag_feedback_adc_val,
+																	(float)state.pot_feedback_adc_val,
+																	_reference_deg,
+																	state.supply_current_a,
+																	state.supply_voltage_v,
+																	state.temperature_degc[0].temp};
+		for(uint8_t i = 0; i < sizeof(debug_values) / sizeof(debug_values[0]); i++)
+		{
+			if(_params->values()->telem_debug_channels & (1U << i))
+			{
+				_telem.write_message(telem::MSG_TAG_DEBUG_VALUES, telem::debug_msg{i, debug_values[i]});
+			}
+		}
+
+		for(size_t i = 0; i < state.nb_temp_sensors; i++)
+		{
+			if(state.temperature_updated & (1 << i))
+			{
+				_telem.write_message(telem::MSG_TAG_TEMPERATURE,
+														 telem::temperature_msg{state.temperature_degc[i].sensor_id, state.temperature_degc[i].temp});
+			}
+		}
+
+		for(size_t i = 0; i < state.nb_load_cell_samples; i++)
+		{
+			const HX711Sample_t &sample = state.load_cell_samples[i];
+			_telem.write_message(telem::MSG_TAG_LOAD_CELL, telem::load_cell_msg{sample.timestamp_us, sample.value, sample.gain});
+		}
+
+		if(state.current_profile_updated)
+		{
+			telem::current_profile_msg profile_msg = {};
+			profile_msg.frame = state.current_profile.frame;
+			profile_msg.n_points = state.current_profile.n_points;
+			for(size_t i = 0; i < state.current_profile.n_points; i++)
+			{
+				profile_msg.offset_us[i] = state.current_profile.offset_us[i];
+				profile_msg.current_a[i] = _sensors->adc_to_current(state.current_profile.adc_val[i]);
+			}
+			_telem.write_message(telem::MSG_TAG_CURRENT_PROFILE, profile_msg);
+		}
+
+		if(++_log_count % _params->values()->telem_stream_status_period == 0)
+		{
+			_telem.write_stream_status_messages();
+		}
+
+		_telem.end_batch();
 
 	}
 };
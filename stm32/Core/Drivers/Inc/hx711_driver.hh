@@ -9,7 +9,52 @@
 #define DRIVERS_INC_HX711_DRIVER_HH_
 
 #include "main.h"
+#include "DeviceInterfaces.hh"
+#include "CircularBuffer.hh"
 
+// Half period of the serial clock, the clock must not stay high for more than 60us
+#define HX711_CLK_HALF_PERIOD_US 10
+
+// Number of buffered samples (power of two), the oldest samples are overwritten when full
+#define HX711_QUEUE_SIZE 16
+
+// Number of samples averaged by default during tare
+#define HX711_TARE_N_SAMPLES 10
+
+// Number of conversions dropped after a gain or rate change (output settling time)
+#define HX711_SETTLING_SAMPLES 4
+
+// Input channel and gain, selected by the number of clock pulses of the previous readout
+typedef enum
+{
+	HX711_GAIN_A_128 = 25,
+	HX711_GAIN_B_32 = 26,
+	HX711_GAIN_A_64 = 27
+} HX711Gain_t;
+
+// Output data rate, selected by the RATE pin
+typedef enum
+{
+	HX711_RATE_10SPS = 0,
+	HX711_RATE_80SPS = 1
+} HX711Rate_t;
+
+typedef struct
+{
+	int32_t value;						// Signed 24 bits conversion result minus the tare offset
+	uint32_t timestamp_us;		// Time at which the data ready edge was detected
+	uint8_t gain;							// HX711Gain_t the conversion was made with
+} HX711Sample_t;
+
+/*
+ * Interrupt driven HX711 reader.
+ *
+ * The falling edge of DOUT (data ready) raises an EXTI interrupt, which starts
+ * a timer. Each timer update interrupt generates one edge of the serial clock,
+ * so the 25 clock pulses of a readout are clocked out in the background while
+ * the control loop keeps running. Completed samples are timestamped and pushed
+ * into a queue read from the main loop.
+ */
 class HX711Driver
 {
 private:
@@ -17,97 +62,374 @@ private:
 	uint16_t _clk_pin;
 	GPIO_TypeDef *_dat_gpio;
 	uint16_t _dat_pin;
-	int32_t _offset = 0;
+	IRQn_Type _dat_irqn;
+	TIM_HandleTypeDef *_htimx;
+	const TimeSourceInterface *_time_source;
+	GPIO_TypeDef *_rate_gpio = nullptr;
+	uint16_t _rate_pin = 0;
+
+	int32_t _offset[3] = {0};						// Tare offset of each HX711Gain_t, applied in the interrupt
+
+	// Channel, gain and rate
+	volatile uint8_t _next_gain = HX711_GAIN_A_128;	// Gain requested for the next conversion
+	uint8_t _conv_gain = HX711_GAIN_A_128;					// Gain of the conversion being read
+	HX711Rate_t _rate = HX711_RATE_10SPS;
+	volatile uint8_t _settling = 0;
+
+	// Readout state machine
+	volatile uint8_t _busy = 0;
+	uint8_t _pulses = HX711_GAIN_A_128;
+	uint8_t _edge = 0;
+	int32_t _raw = 0;
+	uint32_t _timestamp_us = 0;
+
+	// Background tare
+	volatile uint8_t _tare_remaining = 0;
+	uint8_t _tare_n_samples = 0;
+	uint8_t _tare_gain = HX711_GAIN_A_128;
+	int32_t _tare_sum = 0;
+
+	// Completed samples
+	CircularBuffer<HX711Sample_t, HX711_QUEUE_SIZE, OverflowPolicy::Overwrite> _samples;
+
+	// Last two popped samples, used for interpolation
+	HX711Sample_t _prev_sample = {};
+	HX711Sample_t _last_sample = {};
+	uint8_t _n_popped = 0;
 
 public:
 	HX711Driver(GPIO_TypeDef *clk_gpio,
 							uint16_t clk_pin,
 							GPIO_TypeDef *dat_gpio,
-							uint16_t dat_pin) :
+							uint16_t dat_pin,
+							IRQn_Type dat_irqn,
+							TIM_HandleTypeDef *htimx,
+							const TimeSourceInterface *time_source) :
 							_clk_gpio(clk_gpio),
 							_clk_pin(clk_pin),
 							_dat_gpio(dat_gpio),
-							_dat_pin(dat_pin)
+							_dat_pin(dat_pin),
+							_dat_irqn(dat_irqn),
+							_htimx(htimx),
+							_time_source(time_source)
 	{
 	}
 
+	void start(void)
+	{
+		GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+		HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_RESET);
+
+		// Data ready is signalled by a falling edge on DOUT
+		GPIO_InitStruct.Pin = _dat_pin;
+		GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		HAL_GPIO_Init(_dat_gpio, &GPIO_InitStruct);
+
+		__HAL_GPIO_EXTI_CLEAR_IT(_dat_pin);
+		HAL_NVIC_EnableIRQ(_dat_irqn);
+
+		// The edge was missed if a conversion is already waiting
+		if(HAL_GPIO_ReadPin(_dat_gpio, _dat_pin) == GPIO_PIN_RESET)
+		{
+			on_data_ready();
+		}
+	}
+
+	/**
+	 * @brief Returns the most recent sample and drops the older queued ones.
+	 *
+	 * @param data Most recent tared value.
+	 * @return uint8_t 1 if a new sample was available, 0 otherwise.
+	 */
 	uint8_t read(int32_t *data)
 	{
-		*data = 0x0;
+		HX711Sample_t sample;
+		uint8_t available = 0;
+
+		while(read_sample(&sample))
+		{
+			available = 1;
+		}
+
+		if(available)
+		{
+			*data = sample.value;
+		}
+
+		return available;
+	}
 
-		// Check whether data is available
-		if(HAL_GPIO_ReadPin(_dat_gpio, _dat_pin) == GPIO_PIN_SET)
+	/**
+	 * @brief Pops the oldest queued sample.
+	 *
+	 * @param sample Oldest tared sample with its timestamp.
+	 * @return uint8_t 1 if a sample was available, 0 otherwise.
+	 */
+	uint8_t read_sample(HX711Sample_t *sample)
+	{
+		if(_samples.empty())
 		{
 			return 0;
 		}
 
-		for(int8_t i = 0; i < 24; i++)
+		*sample = _samples.get();
+
+		_prev_sample = _last_sample;
+		_last_sample = *sample;
+		if(_n_popped < 2)
 		{
-			// Clock rising edge
-			HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_SET);
-			delay_us(10);
+			_n_popped++;
+		}
 
-			// Clock falling edge
-			HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_RESET);
-			delay_us(10);
+		return 1;
+	}
 
-			// Shift data
-			*data = *data << 1;
+	/**
+	 * @brief Linearly interpolates the two most recently popped samples.
+	 *
+	 * Times before the previous sample or after the last one are clamped to
+	 * the closest sample, there is no extrapolation.
+	 *
+	 * @param timestamp_us Time at which the load cell value is wanted.
+	 * @param data Interpolated tared value.
+	 * @return uint8_t 1 if at least one sample was popped so far, 0 otherwise.
+	 */
+	uint8_t interpolate(uint32_t timestamp_us, int32_t *data)
+	{
+		if(_n_popped == 0)
+		{
+			return 0;
+		}
 
-			// Read and store received bit
-			if(HAL_GPIO_ReadPin(_dat_gpio, _dat_pin) == GPIO_PIN_SET)
-			{
-				*data |= 0b1;
-			}
+		const int32_t dt_samples = (int32_t)(_last_sample.timestamp_us - _prev_sample.timestamp_us);
+		const int32_t dt = (int32_t)(timestamp_us - _prev_sample.timestamp_us);
+
+		if(_n_popped < 2 || dt >= dt_samples || dt_samples <= 0)
+		{
+			*data = _last_sample.value;
+		}
+		else if(dt <= 0)
+		{
+			*data = _prev_sample.value;
+		}
+		else
+		{
+			*data = _prev_sample.value
+					+ (int32_t)((int64_t)(_last_sample.value - _prev_sample.value) * dt / dt_samples);
 		}
 
-		// 25th clock pulse (input: A, gain: 128)
-		HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_SET);
-		delay_us(10);
-		HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_RESET);
-		delay_us(10);
+		return 1;
+	}
 
-		// Convert 24 bits signed data into 32 bits signed data
-		if(*data & 0x800000)
+	/**
+	 * @brief Interpolates the load cell value one sample period before now, so
+	 * 		  the value lies between the two most recently popped samples.
+	 *
+	 * @param data Interpolated tared value.
+	 * @return uint8_t 1 if at least one sample was popped so far, 0 otherwise.
+	 */
+	uint8_t read_interpolated(int32_t *data)
+	{
+		return interpolate(_time_source->now_micros() - get_sample_period_us(), data);
+	}
+
+	// Time between the two most recently popped samples, 0 if unknown
+	uint32_t get_sample_period_us(void)
+	{
+		return _n_popped < 2 ? 0 : _last_sample.timestamp_us - _prev_sample.timestamp_us;
+	}
+
+	/**
+	 * @brief Selects the input channel and gain of the following conversions.
+	 *
+	 * The selection is sent with the next readout, the conversions made during
+	 * the output settling time are dropped.
+	 */
+	void set_gain(HX711Gain_t gain)
+	{
+		if(gain != _next_gain)
 		{
-			*data |= 0xFF000000;
+			_next_gain = gain;
+			_settling = HX711_SETTLING_SAMPLES + 1;
+		}
+	}
+
+	HX711Gain_t get_gain(void)
+	{
+		return (HX711Gain_t)_next_gain;
+	}
+
+	// MCU pin wired to the HX711 RATE input (HX711_RATE_Pin of the board), set as output at 10 SPS
+	void set_rate_pin(GPIO_TypeDef *rate_gpio, uint16_t rate_pin)
+	{
+		GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+		_rate_gpio = rate_gpio;
+		_rate_pin = rate_pin;
+		_rate = HX711_RATE_10SPS;
+
+		HAL_GPIO_WritePin(_rate_gpio, _rate_pin, GPIO_PIN_RESET);
+		GPIO_InitStruct.Pin = _rate_pin;
+		GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+		HAL_GPIO_Init(_rate_gpio, &GPIO_InitStruct);
+	}
+
+	/**
+	 * @brief Selects the output data rate with the RATE pin.
+	 *
+	 * @return uint8_t 1 if the rate is applied, 0 if no rate pin was set (RATE
+	 * 		   hardwired on the board).
+	 */
+	uint8_t set_rate(HX711Rate_t rate)
+	{
+		if(_rate_gpio == nullptr)
+		{
+			return 0;
 		}
 
-		*data -= _offset;
+		if(rate != _rate)
+		{
+			HAL_GPIO_WritePin(_rate_gpio, _rate_pin, rate == HX711_RATE_80SPS ? GPIO_PIN_SET : GPIO_PIN_RESET);
+			_settling = HX711_SETTLING_SAMPLES;
+			_rate = rate;
+		}
 
 		return 1;
 	}
 
 	void reset(void)
 	{
-		HAL_GPIO_WritePin(GPIOB, _clk_pin, GPIO_PIN_SET);
+		HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_SET);
 		delay_us(100);
 		HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_RESET);
 	}
 
-	void tare(void)
+	/**
+	 * @brief Starts a background tare of the selected channel and gain, the
+	 * 		  offset is updated once n_samples conversions have been averaged.
+	 * 		  Does not block.
+	 */
+	void tare(uint8_t n_samples = HX711_TARE_N_SAMPLES)
+	{
+		if(n_samples == 0)
+		{
+			return;
+		}
+
+		__disable_irq();
+		_tare_sum = 0;
+		_tare_n_samples = n_samples;
+		_tare_gain = _next_gain;
+		_tare_remaining = n_samples;
+		__enable_irq();
+	}
+
+	uint8_t tare_in_progress(void)
+	{
+		return _tare_remaining > 0;
+	}
+
+	TIM_TypeDef* get_tim_instance(void)
+	{
+		return _htimx->Instance;
+	}
+
+	uint16_t get_dat_pin(void)
+	{
+		return _dat_pin;
+	}
+
+	// Called from the DOUT falling edge interrupt
+	void on_data_ready(void)
 	{
-		const uint8_t n_readings_max = 10;
-		const uint16_t n_fails_max = 30;
-		uint8_t n_readings = 0;
-		uint16_t n_fails = 0;
-		int32_t sum = 0;
+		if(_busy)
+		{
+			return;
+		}
+
+		// DOUT toggles while the bits are shifted out
+		HAL_NVIC_DisableIRQ(_dat_irqn);
+
+		_busy = 1;
+		_pulses = _next_gain;
+		_edge = 0;
+		_raw = 0;
+		_timestamp_us = _time_source->now_micros();
 
-		while(n_readings < n_readings_max)
+		__HAL_TIM_SET_COUNTER(_htimx, 0);
+		HAL_TIM_Base_Start_IT(_htimx);
+	}
+
+	// Called from the timer update interrupt, generates one clock edge
+	void on_clock_tick(void)
+	{
+		if(!(_edge & 0x01))
 		{
-			int32_t data;
-			if(read(&data))
+			// Clock rising edge
+			HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_SET);
+		}
+		else
+		{
+			// Clock falling edge
+			HAL_GPIO_WritePin(_clk_gpio, _clk_pin, GPIO_PIN_RESET);
+
+			// Read and store received bit
+			if((_edge >> 1) < 24)
 			{
-				n_readings++;
-				sum += data;
+				_raw = _raw << 1;
+				if(HAL_GPIO_ReadPin(_dat_gpio, _dat_pin) == GPIO_PIN_SET)
+				{
+					_raw |= 0b1;
+				}
 			}
-			else if(n_fails++ == n_fails_max)
+		}
+
+		// 25th to 27th clock pulses select the channel and gain of the next conversion
+		if(++_edge == 2 * _pulses)
+		{
+			HAL_TIM_Base_Stop_IT(_htimx);
+			on_readout_cplt();
+		}
+	}
+
+private:
+	void on_readout_cplt(void)
+	{
+		// Convert 24 bits signed data into 32 bits signed data
+		if(_raw & 0x800000)
+		{
+			_raw |= 0xFF000000;
+		}
+
+		const uint8_t gain = _conv_gain;
+		_conv_gain = _pulses;
+
+		if(_settling > 0)
+		{
+			_settling--;
+		}
+		else
+		{
+			if(_tare_remaining > 0 && gain == _tare_gain)
 			{
-				return;
+				_tare_sum += _raw;
+				if(--_tare_remaining == 0)
+				{
+					_offset[gain - HX711_GAIN_A_128] = _tare_sum / _tare_n_samples;
+				}
 			}
-			HAL_Delay(100);
+
+			// Tared with the offset in force at conversion time, queued samples keep it across a tare
+			_samples.put(HX711Sample_t{_raw - _offset[gain - HX711_GAIN_A_128], _timestamp_us, gain});
 		}
-		_offset = sum / n_readings;
+
+		_busy = 0;
+		__HAL_GPIO_EXTI_CLEAR_IT(_dat_pin);
+		HAL_NVIC_EnableIRQ(_dat_irqn);
 	}
 };
 
@@ -11,19 +11,34 @@
 #include "main.h"
 #include <string.h>
 #include "ds18b20_defs.h"
+#include "one_wire_transport.hh"
 
 /** Max number of sensors allowed to be placed on the bus. */
 #define ONE_WIRE_SENSORS_MAX 							12U
 
+/** ROM bits searched per call to busy() with a transport without background transfers, ~0.2ms each. */
+#define ONE_WIRE_SEARCH_BITS_PER_POLL 		8U
+
+typedef enum
+{
+	ONE_WIRE_SEARCH_IDLE = 0,						/*!< no search in progress */
+	ONE_WIRE_SEARCH_COMMAND,						/*!< writing the search ROM command */
+	ONE_WIRE_SEARCH_BITS,								/*!< reading a ROM bit and its complement */
+	ONE_WIRE_SEARCH_LAST_WRITE					/*!< writing the direction of the last ROM bit */
+} OneWireSearchState_t;
+
 class OneWireDriver
 {
 
 private:
-	GPIO_TypeDef *_gpiox; 													/*!< gpiox to be used for I/O functions */
-	uint16_t _gpio_pin; 														/*!< gpio pin to be used for I/O functions */
+	OneWireTransportInterface *_transport; 					/*!< physical layer of the bus */
 	uint8_t _last_discrepancy = 0; 									/*!< search private */
 	uint8_t _last_family_discrepancy = 0; 					/*!< search private */
 	uint8_t _last_device_flag = 0; 									/*!< search private */
+	volatile OneWireSearchState_t _search_state = ONE_WIRE_SEARCH_IDLE; /*!< search private */
+	uint8_t _id_bit_number = 0; 										/*!< search private, ROM bit being searched (1 to 64) */
+	uint8_t _last_zero = 0; 												/*!< search private */
+	uint8_t _search_result = 0; 										/*!< 1 if the last search found a device */
 
 public:
 	size_t _num_roms = 0; 													/*!< number of devices found */
@@ -31,52 +46,54 @@ public:
 	uint8_t _found_roms[ONE_WIRE_SENSORS_MAX][8]; 	/*!< list of 8-bytes address of all devices found */
 
 public:
-	OneWireDriver(GPIO_TypeDef *gpiox, uint16_t gpio_pin) :
-			_gpiox(gpiox), _gpio_pin(gpio_pin)
+	OneWireDriver(OneWireTransportInterface *transport) :
+			_transport(transport)
 	{
+		_transport->set_complete_callback(transfer_complete_callback, this);
 	}
 
-private:
-	// GPIO_SETPINASINPUT - Set GPIO pin selected as input (floating).
-	//
-	void gpio_set_pin_as_input();
-
-	// GPIO_SETPINASOUTPUT - Set GPIO pin selected as output open-drain.
-	//
-	void gpio_set_pin_as_output();
-
 public:
 	/**
-	 * @brief Performs a reset on the one-wire-bus using the GPIO driver and listens
-	 * 		  for presence detect pulses.
+	 * @brief Performs a reset on the one-wire-bus and listens for presence
+	 * 		  detect pulses.
 	 *
 	 * A reset is issued before each command and puts all sensors on the bus in a
 	 * defined state.
 	 *
-	 * @note  The reset/detect sequence takes ~960µs.
 	 * @param None.
-	 * @return uint8_t If sensors were detected on the bus. If 1, there are active
-	 * 		   sensors. If 0, none were found.
+	 * @return uint8_t 0 if sensors were detected on the bus, 1 if none were found.
 	 */
 	uint8_t reset();
 
-	// READ_BIT - reads a bit from the one-wire bus. Use GPIO for communication.
-	// The delay required for a read is 15us.
+	// READ_BIT - reads a bit from the one-wire bus.
 	//
 	uint8_t read_bit();
 
-	// WRITE_BIT - writes a bit to the one-wire bus, passed in bitval. Use GPIO for communication.
+	// WRITE_BIT - writes a bit to the one-wire bus, passed in bitval.
 	//
 	void write_bit(uint8_t bit);
 
-	// READ_BYTE - reads a byte from the one-wire bus. Uses USART for communication.
+	// READ_BYTE - reads a byte from the one-wire bus.
 	//
 	uint8_t read_byte();
 
-	// WRITE_BYTE - writes a byte to the one-wire bus. Uses USART for communication.
+	// WRITE_BYTE - writes a byte to the one-wire bus.
 	//
 	void write_byte(uint8_t byte);
 
+	// START_WRITE - starts writing bytes to the bus, in the background if the transport supports it.
+	//
+	uint8_t start_write(const uint8_t *data, size_t len);
+
+	// START_READ - starts reading bytes from the bus, data is valid once busy() returns 0.
+	//
+	uint8_t start_read(uint8_t *data, size_t len);
+
+	// BUSY - returns 1 while a transfer started with start_write() or start_read(), or a search started
+	// with start_search(), is running. Advances the search with a transport without background transfers.
+	//
+	uint8_t busy();
+
 	// crc8 - calculates crc given the data and the length required and return the value.
 	//
 	uint8_t crc8(uint8_t *addr, uint8_t len);
@@ -85,7 +102,29 @@ public:
 	//
 	void reset_search();
 
-	// SEARCH - performs a search on the bus using the ROM search command and algorithm detailed in the datasheet of DS18B20 sensor.
+	/**
+	 * @brief Starts searching the next device on the bus, using the ROM search command and
+	 * 		  algorithm detailed in the datasheet of DS18B20 sensor. Call reset_search() first
+	 * 		  to search from the first device.
+	 *
+	 * Only the reset pulse is issued before returning. Each ROM bit is then one transfer
+	 * (the direction of the previous bit, the bit and its complement), the next one being
+	 * started from the completion interrupt of the transport. Without background transfers,
+	 * busy() searches ONE_WIRE_SEARCH_BITS_PER_POLL bits per call.
+	 *
+	 * The search is complete once busy() returns 0, see get_search_result().
+	 */
+	void start_search();
+
+	// GET_SEARCH_RESULT - returns 1 if the last search found a device, its ROM is in _rom_no.
+	//
+	uint8_t get_search_result();
+
+	// HOT_PLUG_DETECTED - returns 1 if a device issued a presence pulse on the idle bus since the last call.
+	//
+	uint8_t hot_plug_detected();
+
+	// SEARCH - performs a search on the bus and waits for its completion.
 	//
 	uint8_t search();
 
@@ -105,6 +144,29 @@ public:
 	//
 	uint8_t number_of_roms();
 
+private:
+	// SEARCH_STEP - handles the completed transfer of the search and starts the next one.
+	//
+	void search_step();
+
+	// START_SEARCH_BITS - starts the slots of the next search transfer, ends the search if they cannot be started.
+	//
+	void start_search_bits(uint8_t bits, uint8_t n_slots);
+
+	// SEARCH_END - records the result of the search and the state of the next one.
+	//
+	void search_end(uint8_t found);
+
+	static void transfer_complete_callback(void *context)
+	{
+		OneWireDriver *driver = static_cast<OneWireDriver*>(context);
+
+		if(driver->_search_state != ONE_WIRE_SEARCH_IDLE)
+		{
+			driver->search_step();
+		}
+	}
+
 };
 
 #endif /* DRIVERS_INC_ONE_WIRE_DRIVER_HH_ */
@@ -0,0 +1,322 @@
+/**
+ * @file    one_wire_timer_transport.hh
+ * @brief   1-wire transport generated by a timer, for pins without a UART.
+ *
+ * The timer counts at 1 MHz and each counter period is one time slot. An output
+ * compare channel in PWM mode (active low, open drain) pulls the line low at
+ * the start of the slot for the duration held in its compare register:
+ *  - write 1: 6us, write 0: 60us, read: 2us.
+ *
+ * The compare event of each slot requests a DMA transfer that loads the pulse
+ * width of the next slot from a slot buffer into the preloaded compare register.
+ * A second channel captures the rising edges of the same pin (indirect input),
+ * a DMA stores the time at which the line went back high in each slot. A slave
+ * answering 0 to a read slot holds the line low past the 15us sampling point.
+ *
+ * A whole transfer therefore runs without the CPU and without delay_us(), the
+ * completion is signalled by the capture DMA interrupt, which also calls the
+ * completion callback to chain the next transfer. The reset pulse uses
+ * the same channels in one-pulse mode, the presence pulse is the rising edge
+ * captured after the master released the line.
+ */
+
+#pragma once
+
+#include "one_wire_transport.hh"
+
+#define ONE_WIRE_TIMER_SLOT_US 				70U
+#define ONE_WIRE_TIMER_RESET_SLOT_US 	960U
+#define ONE_WIRE_TIMER_RESET_LOW_US 	480U
+#define ONE_WIRE_TIMER_WRITE_1_LOW_US 6U
+#define ONE_WIRE_TIMER_WRITE_0_LOW_US 60U
+#define ONE_WIRE_TIMER_READ_LOW_US 		2U
+
+/** The line is sampled 15us after the start of a read slot. */
+#define ONE_WIRE_TIMER_SAMPLE_US 			15U
+
+/** Presence pulses start 15us to 60us after the line was released. */
+#define ONE_WIRE_TIMER_PRESENCE_MIN_US (ONE_WIRE_TIMER_RESET_LOW_US + 15U)
+
+/** Max number of bytes of a single transfer, a match ROM command followed by a function command. */
+#define ONE_WIRE_TIMER_MAX_BYTES 			10U
+
+/** Timeout of a transfer, 10 bytes take 5.6ms. */
+#define ONE_WIRE_TIMER_TIMEOUT_MS 		20U
+
+class OneWireTimerTransport : public OneWireTransportInterface
+{
+private:
+	TIM_HandleTypeDef *_htimx;
+	uint32_t _out_channel;						// PWM output driving the line
+	uint32_t _in_channel;							// Input capture of the output pin (indirect)
+	DMA_HandleTypeDef *_hdma_out;			// Triggered by the output compare event
+	DMA_HandleTypeDef *_hdma_in;			// Triggered by the input capture event
+
+	// Pulse width of each slot, followed by an idle slot
+	uint16_t _out_slots[ONE_WIRE_TIMER_MAX_BYTES * 8 + 1];
+	// Time at which the line was released in each slot
+	uint16_t _in_slots[ONE_WIRE_TIMER_MAX_BYTES * 8];
+
+	// Destination of the transfer in progress, decoded on completion
+	uint8_t *_rx_data = nullptr;
+	size_t _len = 0;
+	size_t _n_slots = 0;
+	volatile uint8_t _busy = 0;
+	uint32_t _start_ms = 0;
+
+public:
+	OneWireTimerTransport(TIM_HandleTypeDef *htimx, uint32_t out_channel, uint32_t in_channel,
+												DMA_HandleTypeDef *hdma_out, DMA_HandleTypeDef *hdma_in) :
+			_htimx(htimx), _out_channel(out_channel), _in_channel(in_channel),
+			_hdma_out(hdma_out), _hdma_in(hdma_in)
+	{
+	}
+
+	uint8_t reset() override
+	{
+		wait_idle();
+
+		// Single reset slot in one-pulse mode, the counter stops by itself
+		stop();
+		__HAL_TIM_SET_AUTORELOAD(_htimx, ONE_WIRE_TIMER_RESET_SLOT_US - 1);
+		_htimx->Instance->CR1 |= TIM_CR1_OPM;
+		ccr(_out_channel) = ONE_WIRE_TIMER_RESET_LOW_US;
+		_htimx->Instance->EGR = TIM_EGR_UG;
+		__HAL_TIM_CLEAR_FLAG(_htimx, cc_flag(_in_channel));
+		_htimx->Instance->CR1 |= TIM_CR1_CEN;
+
+		while(_htimx->Instance->CR1 & TIM_CR1_CEN)
+		{
+		}
+
+		// The last rising edge is the end of the presence pulse if a slave answered
+		const uint8_t presence = __HAL_TIM_GET_FLAG(_htimx, cc_flag(_in_channel))
+				&& ccr(_in_channel) >= ONE_WIRE_TIMER_PRESENCE_MIN_US;
+
+		_htimx->Instance->CR1 &= ~TIM_CR1_OPM;
+		stop();
+
+		return !presence;
+	}
+
+	uint8_t read_bit() override
+	{
+		uint8_t byte = 0;
+
+		wait_idle();
+		_out_slots[0] = ONE_WIRE_TIMER_READ_LOW_US;
+		_rx_data = &byte;
+		_len = 1;
+		start_slots(1);
+		wait_idle();
+
+		return byte & 0x01;
+	}
+
+	void write_bit(uint8_t bit) override
+	{
+		wait_idle();
+		_out_slots[0] = bit ? ONE_WIRE_TIMER_WRITE_1_LOW_US : ONE_WIRE_TIMER_WRITE_0_LOW_US;
+		_rx_data = nullptr;
+		start_slots(1);
+		wait_idle();
+	}
+
+	uint8_t read_byte() override
+	{
+		uint8_t byte = 0;
+
+		wait_idle();
+		start_read(&byte, 1);
+		wait_idle();
+
+		return byte;
+	}
+
+	void write_byte(uint8_t byte) override
+	{
+		wait_idle();
+		start_write(&byte, 1);
+		wait_idle();
+	}
+
+	uint8_t start_write(const uint8_t *data, size_t len) override
+	{
+		if(len > ONE_WIRE_TIMER_MAX_BYTES || busy())
+		{
+			return 0;
+		}
+
+		for(size_t i = 0; i < len; i++)
+		{
+			for(uint8_t k = 0; k < 8; k++)
+			{
+				_out_slots[8 * i + k] = (data[i] >> k) & 0x01 ? ONE_WIRE_TIMER_WRITE_1_LOW_US : ONE_WIRE_TIMER_WRITE_0_LOW_US;
+			}
+		}
+
+		_rx_data = nullptr;
+		return start_slots(8 * len);
+	}
+
+	uint8_t start_read(uint8_t *data, size_t len) override
+	{
+		if(len > ONE_WIRE_TIMER_MAX_BYTES || busy())
+		{
+			return 0;
+		}
+
+		for(size_t i = 0; i < 8 * len; i++)
+		{
+			_out_slots[i] = ONE_WIRE_TIMER_READ_LOW_US;
+		}
+
+		_rx_data = data;
+		_len = len;
+		return start_slots(8 * len);
+	}
+
+	uint8_t start_bits(uint8_t bits, uint8_t n_slots) override
+	{
+		if(n_slots > 8 || busy())
+		{
+			return 0;
+		}
+
+		for(uint8_t k = 0; k < n_slots; k++)
+		{
+			_out_slots[k] = (bits >> k) & 0x01 ? ONE_WIRE_TIMER_READ_LOW_US : ONE_WIRE_TIMER_WRITE_0_LOW_US;
+		}
+
+		_rx_data = &_bits;
+		_len = 1;
+		return start_slots(n_slots);
+	}
+
+	uint8_t busy() override
+	{
+		if(_busy && HAL_GetTick() - _start_ms > ONE_WIRE_TIMER_TIMEOUT_MS)
+		{
+			// Edges lost, e.g. bus shorted
+			HAL_DMA_Abort(_hdma_in);
+			stop();
+			_busy = 0;
+		}
+
+		return _busy;
+	}
+
+	uint8_t runs_in_background() override
+	{
+		return 1;
+	}
+
+	// The capture channel keeps latching rising edges while the counter is stopped
+	uint8_t hot_plug_detected() override
+	{
+		if(busy() || !__HAL_TIM_GET_FLAG(_htimx, cc_flag(_in_channel)))
+		{
+			return 0;
+		}
+
+		__HAL_TIM_CLEAR_FLAG(_htimx, cc_flag(_in_channel));
+		return 1;
+	}
+
+	// Called from the capture DMA transfer complete interrupt, every slot has been captured
+	void on_capture_cplt(void)
+	{
+		stop();
+
+		if(_rx_data != nullptr)
+		{
+			for(size_t i = 0; i < _len; i++)
+			{
+				_rx_data[i] = 0;
+			}
+			for(size_t i = 0; i < _n_slots; i++)
+			{
+				if(_in_slots[i] < ONE_WIRE_TIMER_SAMPLE_US)
+				{
+					_rx_data[i / 8] |= (1 << (i % 8));
+				}
+			}
+			_rx_data = nullptr;
+		}
+
+		_busy = 0;
+		complete();
+	}
+
+private:
+	static void capture_cplt_callback(DMA_HandleTypeDef *hdma)
+	{
+		static_cast<OneWireTimerTransport*>(hdma->Parent)->on_capture_cplt();
+	}
+
+	uint8_t start_slots(size_t n_slots)
+	{
+		_busy = 1;
+		_start_ms = HAL_GetTick();
+		_n_slots = n_slots;
+
+		stop();
+		__HAL_TIM_SET_AUTORELOAD(_htimx, ONE_WIRE_TIMER_SLOT_US - 1);
+
+		// First slot loaded right away, the DMA loads the following ones and an idle slot
+		_out_slots[n_slots] = 0;
+		ccr(_out_channel) = _out_slots[0];
+		_htimx->Instance->EGR = TIM_EGR_UG;
+		__HAL_TIM_CLEAR_FLAG(_htimx, cc_flag(_out_channel) | cc_flag(_in_channel));
+
+		_hdma_in->Parent = this;
+		_hdma_in->XferCpltCallback = capture_cplt_callback;
+		_hdma_in->XferHalfCpltCallback = NULL;
+		if(HAL_DMA_Start(_hdma_out, (uint32_t)&_out_slots[1], (uint32_t)&ccr(_out_channel), n_slots) != HAL_OK
+				|| HAL_DMA_Start_IT(_hdma_in, (uint32_t)&ccr(_in_channel), (uint32_t)_in_slots, n_slots) != HAL_OK)
+		{
+			stop();
+			_busy = 0;
+			return 0;
+		}
+
+		__HAL_TIM_ENABLE_DMA(_htimx, cc_dma(_out_channel) | cc_dma(_in_channel));
+		_htimx->Instance->CR1 |= TIM_CR1_CEN;
+
+		return 1;
+	}
+
+	// Stops the counter and releases the line
+	void stop(void)
+	{
+		_htimx->Instance->CR1 &= ~TIM_CR1_CEN;
+		__HAL_TIM_DISABLE_DMA(_htimx, cc_dma(_out_channel) | cc_dma(_in_channel));
+		HAL_DMA_Abort(_hdma_out);
+
+		ccr(_out_channel) = 0;
+		_htimx->Instance->EGR = TIM_EGR_UG;
+	}
+
+	void wait_idle(void)
+	{
+		while(busy())
+		{
+		}
+	}
+
+	// CCR1 to CCR4, CCxIF and CCxDE are contiguous, TIM_CHANNEL_x is 4 * (x - 1)
+	volatile uint32_t& ccr(uint32_t channel)
+	{
+		return (&_htimx->Instance->CCR1)[channel >> 2];
+	}
+
+	uint32_t cc_flag(uint32_t channel)
+	{
+		return TIM_FLAG_CC1 << (channel >> 2);
+	}
+
+	uint32_t cc_dma(uint32_t channel)
+	{
+		return TIM_DMA_CC1 << (channel >> 2);
+	}
+};
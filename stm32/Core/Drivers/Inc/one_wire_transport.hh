@@ -0,0 +1,200 @@
+/**
+ * @file    one_wire_transport.hh
+ * @brief   Physical layer of the 1-wire bus.
+ *
+ * The 1-wire protocol logic (ROM search, CRC, device commands) only needs to
+ * generate reset pulses and read/write time slots. A transport implements these
+ * slots either by bit banging a GPIO pin (OneWireGpioTransport) or with a UART
+ * in single-wire half-duplex mode (OneWireUartTransport).
+ *
+ * Transports may additionally run multi-byte transfers in the background. The
+ * default implementation completes them synchronously, so callers only have to
+ * poll busy() before using the data. Background transports call the completion
+ * callback from their interrupt at the end of each transfer, so that sequences
+ * of transfers (e.g. the ROM search) can be chained without the CPU waiting.
+ */
+
+#pragma once
+
+#include "main.h"
+#include <stddef.h>
+
+/** Called from the transport interrupt at the end of a background transfer. */
+typedef void (*OneWireCompleteCallback_t)(void *context);
+
+class OneWireTransportInterface
+{
+protected:
+	uint8_t _bits = 0;																/*!< levels read by start_bits() */
+	OneWireCompleteCallback_t _complete_callback = nullptr;
+	void *_complete_context = nullptr;
+
+public:
+	/**
+	 * @brief Issues a reset pulse and listens for presence pulses.
+	 *
+	 * @return uint8_t 0 if a presence pulse was detected, 1 otherwise.
+	 */
+	virtual uint8_t reset() = 0;
+
+	virtual uint8_t read_bit() = 0;
+
+	virtual void write_bit(uint8_t bit) = 0;
+
+	virtual uint8_t read_byte()
+	{
+		uint8_t i = 8, byte = 0;
+
+		while(i--)
+		{
+			byte >>= 1;
+			byte |= (read_bit() << 7);
+		}
+
+		return byte;
+	}
+
+	virtual void write_byte(uint8_t byte)
+	{
+		uint8_t i = 8;
+
+		while(i--)
+		{
+			write_bit(byte & 0x01); // lsb first
+			byte >>= 1;
+		}
+	}
+
+	/**
+	 * @brief Starts writing len bytes, the data is copied before returning.
+	 *
+	 * @return uint8_t 1 if the transfer was started, 0 otherwise.
+	 */
+	virtual uint8_t start_write(const uint8_t *data, size_t len)
+	{
+		for(size_t i = 0; i < len; i++)
+		{
+			write_byte(data[i]);
+		}
+		return 1;
+	}
+
+	/**
+	 * @brief Starts reading len bytes into data, which must stay valid until
+	 * 		  busy() returns 0.
+	 *
+	 * @return uint8_t 1 if the transfer was started, 0 otherwise.
+	 */
+	virtual uint8_t start_read(uint8_t *data, size_t len)
+	{
+		for(size_t i = 0; i < len; i++)
+		{
+			data[i] = read_byte();
+		}
+		return 1;
+	}
+
+	/**
+	 * @brief Starts n_slots time slots (at most 8), slot k writes bit k of bits.
+	 * 		  A 1 slot also reads the line, the levels read are returned by
+	 * 		  get_bits() once busy() returns 0.
+	 *
+	 * @return uint8_t 1 if the slots were started, 0 otherwise.
+	 */
+	virtual uint8_t start_bits(uint8_t bits, uint8_t n_slots)
+	{
+		_bits = 0;
+		for(uint8_t k = 0; k < n_slots; k++)
+		{
+			if((bits >> k) & 0x01)
+			{
+				_bits |= read_bit() << k;
+			}
+			else
+			{
+				write_bit(0);
+			}
+		}
+		return 1;
+	}
+
+	uint8_t get_bits()
+	{
+		return _bits;
+	}
+
+	// 1 while a transfer started with start_write(), start_read() or start_bits() is running
+	virtual uint8_t busy()
+	{
+		return 0;
+	}
+
+	// 1 if transfers complete in the background and call the completion callback
+	virtual uint8_t runs_in_background()
+	{
+		return 0;
+	}
+
+	/**
+	 * @brief Checks whether a device pulled the line low while the bus was idle since the
+	 * 		  last call, i.e. the presence pulse a device issues when it powers up on the bus.
+	 *
+	 * @return uint8_t 1 if a device was plugged in, 0 otherwise or if the transport cannot
+	 * 		   see the line between transfers.
+	 */
+	virtual uint8_t hot_plug_detected()
+	{
+		return 0;
+	}
+
+	void set_complete_callback(OneWireCompleteCallback_t callback, void *context)
+	{
+		_complete_callback = callback;
+		_complete_context = context;
+	}
+
+protected:
+	void complete()
+	{
+		if(_complete_callback != nullptr)
+		{
+			_complete_callback(_complete_context);
+		}
+	}
+};
+
+/*
+ * Bit banged transport, each time slot is generated with delay_us() and
+ * may be stretched by interrupts.
+ */
+class OneWireGpioTransport : public OneWireTransportInterface
+{
+private:
+	GPIO_TypeDef *_gpiox; 													/*!< gpiox to be used for I/O functions */
+	uint16_t _gpio_pin; 														/*!< gpio pin to be used for I/O functions */
+
+public:
+	OneWireGpioTransport(GPIO_TypeDef *gpiox, uint16_t gpio_pin) :
+			_gpiox(gpiox), _gpio_pin(gpio_pin)
+	{
+	}
+
+	/**
+	 * @note  The reset/detect sequence takes ~960µs.
+	 */
+	uint8_t reset() override;
+
+	// The delay required for a read is 15us.
+	uint8_t read_bit() override;
+
+	void write_bit(uint8_t bit) override;
+
+private:
+	// GPIO_SETPINASINPUT - Set GPIO pin selected as input (floating).
+	//
+	void gpio_set_pin_as_input();
+
+	// GPIO_SETPINASOUTPUT - Set GPIO pin selected as output open-drain.
+	//
+	void gpio_set_pin_as_output();
+};
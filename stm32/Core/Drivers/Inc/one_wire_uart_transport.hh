@@ -0,0 +1,278 @@
+/**
+ * @file    one_wire_uart_transport.hh
+ * @brief   1-wire transport over a UART in single-wire half-duplex mode.
+ *
+ * Each 1-wire time slot is encoded as one UART byte, the receiver sees the
+ * line level of the whole slot:
+ *  - reset: 0xF0 at 9600 baud, a presence pulse corrupts the echoed byte,
+ *  - write 1 / read: 0xFF at 115200 baud, the echo is 0xFF if the slave left the
+ *    line high,
+ *  - write 0: 0x00 at 115200 baud.
+ *
+ * The slots of a transfer are sent and received by DMA, so the timing is
+ * generated by the UART and a whole scratchpad read runs without the CPU.
+ * A transfer is complete once the last echo is received and the transmitter
+ * is idle, the completion callback is called from the later of the two
+ * interrupts.
+ * The TX pin must be open drain with the bus pull-up.
+ */
+
+#pragma once
+
+#include "one_wire_transport.hh"
+#include <string.h>
+
+#define ONE_WIRE_UART_RESET_BAUDRATE 	9600U
+#define ONE_WIRE_UART_DATA_BAUDRATE 	115200U
+
+/** Max number of bytes of a single transfer, a match ROM command followed by a function command. */
+#define ONE_WIRE_UART_MAX_BYTES 			10U
+
+/** Timeout of a transfer, 10 bytes take ~7ms. */
+#define ONE_WIRE_UART_TIMEOUT_MS 			20U
+
+#define ONE_WIRE_UART_SLOT_RESET 			0xF0
+#define ONE_WIRE_UART_SLOT_1 					0xFF
+#define ONE_WIRE_UART_SLOT_0 					0x00
+
+class OneWireUartTransport : public OneWireTransportInterface
+{
+private:
+	UART_HandleTypeDef *_huartx;
+
+	// One UART byte per time slot
+	uint8_t _tx_slots[ONE_WIRE_UART_MAX_BYTES * 8];
+	uint8_t _rx_slots[ONE_WIRE_UART_MAX_BYTES * 8];
+
+	// Destination of the transfer in progress, decoded on completion
+	uint8_t *_rx_data = nullptr;
+	size_t _len = 0;
+	size_t _n_slots = 0;
+	volatile uint8_t _busy = 0;
+	uint32_t _start_ms = 0;
+
+public:
+	OneWireUartTransport(UART_HandleTypeDef *huartx) :
+			_huartx(huartx)
+	{
+	}
+
+	uint8_t reset() override
+	{
+		wait_idle();
+
+		set_baudrate(ONE_WIRE_UART_RESET_BAUDRATE);
+		_tx_slots[0] = ONE_WIRE_UART_SLOT_RESET;
+		_rx_slots[0] = ONE_WIRE_UART_SLOT_RESET;
+		_rx_data = nullptr;
+		start_slots(1);
+		wait_idle();
+		set_baudrate(ONE_WIRE_UART_DATA_BAUDRATE);
+
+		// Unchanged echo means nobody pulled the line low
+		return _rx_slots[0] == ONE_WIRE_UART_SLOT_RESET;
+	}
+
+	uint8_t read_bit() override
+	{
+		return transfer_slot(ONE_WIRE_UART_SLOT_1) == ONE_WIRE_UART_SLOT_1;
+	}
+
+	void write_bit(uint8_t bit) override
+	{
+		transfer_slot(bit ? ONE_WIRE_UART_SLOT_1 : ONE_WIRE_UART_SLOT_0);
+	}
+
+	uint8_t read_byte() override
+	{
+		uint8_t byte = 0;
+
+		wait_idle();
+		start_read(&byte, 1);
+		wait_idle();
+
+		return byte;
+	}
+
+	void write_byte(uint8_t byte) override
+	{
+		wait_idle();
+		start_write(&byte, 1);
+		wait_idle();
+	}
+
+	uint8_t start_write(const uint8_t *data, size_t len) override
+	{
+		if(len > ONE_WIRE_UART_MAX_BYTES || busy())
+		{
+			return 0;
+		}
+
+		for(size_t i = 0; i < len; i++)
+		{
+			for(uint8_t k = 0; k < 8; k++)
+			{
+				_tx_slots[8 * i + k] = (data[i] >> k) & 0x01 ? ONE_WIRE_UART_SLOT_1 : ONE_WIRE_UART_SLOT_0;
+			}
+		}
+
+		_rx_data = nullptr;
+		return start_slots(8 * len);
+	}
+
+	uint8_t start_read(uint8_t *data, size_t len) override
+	{
+		if(len > ONE_WIRE_UART_MAX_BYTES || busy())
+		{
+			return 0;
+		}
+
+		memset(_tx_slots, ONE_WIRE_UART_SLOT_1, 8 * len);
+
+		_rx_data = data;
+		_len = len;
+		return start_slots(8 * len);
+	}
+
+	uint8_t start_bits(uint8_t bits, uint8_t n_slots) override
+	{
+		if(n_slots > 8 || busy())
+		{
+			return 0;
+		}
+
+		for(uint8_t k = 0; k < n_slots; k++)
+		{
+			_tx_slots[k] = (bits >> k) & 0x01 ? ONE_WIRE_UART_SLOT_1 : ONE_WIRE_UART_SLOT_0;
+		}
+
+		_rx_data = &_bits;
+		_len = 1;
+		return start_slots(n_slots);
+	}
+
+	uint8_t busy() override
+	{
+		if((_busy || _huartx->gState != HAL_UART_STATE_READY)
+				&& HAL_GetTick() - _start_ms > ONE_WIRE_UART_TIMEOUT_MS)
+		{
+			// Slots lost, e.g. after a framing error
+			HAL_UART_Abort(_huartx);
+			_busy = 0;
+		}
+
+		return _busy || _huartx->gState != HAL_UART_STATE_READY;
+	}
+
+	uint8_t runs_in_background() override
+	{
+		return 1;
+	}
+
+	// The receiver stays enabled between transfers, a low pulse is received as a byte or a framing error
+	uint8_t hot_plug_detected() override
+	{
+		if(busy() || !(__HAL_UART_GET_FLAG(_huartx, UART_FLAG_RXNE) || __HAL_UART_GET_FLAG(_huartx, UART_FLAG_FE)))
+		{
+			return 0;
+		}
+
+		// Drop the byte, it would otherwise be taken as the echo of the next slot
+		__HAL_UART_SEND_REQ(_huartx, UART_RXDATA_FLUSH_REQUEST);
+		__HAL_UART_CLEAR_FLAG(_huartx, UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_OREF);
+		return 1;
+	}
+
+	USART_TypeDef* get_instance(void)
+	{
+		return _huartx->Instance;
+	}
+
+	// Called from the UART receive complete interrupt, all slots have been echoed
+	void on_rx_completed(void)
+	{
+		if(_rx_data != nullptr)
+		{
+			for(size_t i = 0; i < _len; i++)
+			{
+				_rx_data[i] = 0;
+			}
+			for(size_t i = 0; i < _n_slots; i++)
+			{
+				if(_rx_slots[i] == ONE_WIRE_UART_SLOT_1)
+				{
+					_rx_data[i / 8] |= (1 << (i % 8));
+				}
+			}
+			_rx_data = nullptr;
+		}
+
+		_busy = 0;
+
+		// The transmit complete interrupt usually comes half a bit later
+		if(_huartx->gState == HAL_UART_STATE_READY)
+		{
+			complete();
+		}
+	}
+
+	// Called from the UART transmit complete interrupt
+	void on_tx_completed(void)
+	{
+		if(!_busy)
+		{
+			complete();
+		}
+	}
+
+private:
+	uint8_t start_slots(size_t n_slots)
+	{
+		_busy = 1;
+		_start_ms = HAL_GetTick();
+		_n_slots = n_slots;
+
+		// The receiver sees the transmitted slots on the shared line
+		if(HAL_UART_Receive_DMA(_huartx, _rx_slots, n_slots) != HAL_OK)
+		{
+			_busy = 0;
+			return 0;
+		}
+		if(HAL_UART_Transmit_DMA(_huartx, _tx_slots, n_slots) != HAL_OK)
+		{
+			HAL_UART_AbortReceive(_huartx);
+			_busy = 0;
+			return 0;
+		}
+
+		return 1;
+	}
+
+	uint8_t transfer_slot(uint8_t slot)
+	{
+		wait_idle();
+
+		_tx_slots[0] = slot;
+		_rx_data = nullptr;
+		start_slots(1);
+		wait_idle();
+
+		return _rx_slots[0];
+	}
+
+	void wait_idle(void)
+	{
+		while(busy())
+		{
+		}
+	}
+
+	void set_baudrate(uint32_t baudrate)
+	{
+		if(_huartx->Init.BaudRate != baudrate)
+		{
+			_huartx->Init.BaudRate = baudrate;
+			HAL_HalfDuplex_Init(_huartx);
+		}
+	}
+};
@@ -0,0 +1,248 @@
+/**
+ * @file    param_server.hh
+ * @brief   Typed parameters tunable at runtime over the host link.
+ *
+ * Each parameter is one entry of PARAM_TABLE: its id, the name of its member
+ * in Params_t, its type and its range and default value. The drivers read the
+ * Params_t members directly, so a read costs the same as any other member;
+ * get, set and list go through switches generated from the table (O(1) by id).
+ * Set values outside the range are rejected.
+ *
+ * With PARAM_FLASH_PERSISTENCE the values can be saved to the last flash page
+ * (reserved in the linker script) and are restored at startup. Saved values
+ * are checked against the current ranges, so a firmware update changing a
+ * range falls back to the default.
+ *
+ * python/gen_commands.py reads the table for the host encoders.
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include "main.h"
+#include "CRC.hh"
+#include "filter.hh"
+
+// Wire types of the parameters, all 4 bytes little endian
+typedef enum
+{
+	PARAM_TYPE_U32								= 0x00,
+	PARAM_TYPE_I32								= 0x01,
+	PARAM_TYPE_F32								= 0x02,
+} ParamType_t;
+
+// X(id enumerator, id, member, type, min, max, default)
+#define PARAM_TABLE(X) \
+	X(PARAM_MAG_FILTER_WINDOW,				0x00, mag_filter_window,					uint32_t,	1,			FILTER_BUFFER_SIZE,	16) \
+	X(PARAM_TELEM_DEBUG_CHANNELS,			0x01, telem_debug_channels,				uint32_t,	0,			0x7F,								0x00) \
+	X(PARAM_TELEM_STREAM_STATUS_PERIOD,	0x02, telem_stream_status_period,	uint32_t,	1,			3000,								50) \
+	X(PARAM_VOLTAGE_GAIN,							0x03, voltage_gain,								float,		0.5f,		1.5f,								1.0f) \
+	X(PARAM_VOLTAGE_OFFSET_V,					0x04, voltage_offset_v,						float,		-2.0f,	2.0f,								0.44f) \
+	X(PARAM_CURRENT_GAIN,							0x05, current_gain,								float,		0.5f,		1.5f,								1.03f) \
+	X(PARAM_CURRENT_OFFSET_A,					0x06, current_offset_a,						float,		-2.0f,	2.0f,								0.2f) \
+	X(PARAM_LOAD_CELL_GAIN,						0x07, load_cell_gain,							uint32_t,	25,			27,									25)
+
+#define PARAM_ENUM(id_enum, id, member, type, min, max, def) id_enum = id,
+
+typedef enum
+{
+	PARAM_TABLE(PARAM_ENUM)
+	PARAM_ID_MAX,
+} ParamId_t;
+
+#undef PARAM_ENUM
+
+#define PARAM_MEMBER(id_enum, id, member, type, min, max, def) type member;
+
+// Current values, read directly by the drivers
+typedef struct
+{
+	PARAM_TABLE(PARAM_MEMBER)
+} Params_t;
+
+#undef PARAM_MEMBER
+
+#define PARAM_DEFAULT(id_enum, id, member, type, min, max, def) def,
+
+constexpr Params_t PARAM_DEFAULTS = { PARAM_TABLE(PARAM_DEFAULT) };
+
+#undef PARAM_DEFAULT
+
+template<class T> struct ParamTypeOf;
+template<> struct ParamTypeOf<uint32_t> { static constexpr ParamType_t value = PARAM_TYPE_U32; };
+template<> struct ParamTypeOf<int32_t> { static constexpr ParamType_t value = PARAM_TYPE_I32; };
+template<> struct ParamTypeOf<float> { static constexpr ParamType_t value = PARAM_TYPE_F32; };
+
+// Description of a parameter, values as their raw 4 bytes
+typedef struct
+{
+	uint8_t id;
+	uint8_t type;
+	uint32_t value;
+	uint32_t min;
+	uint32_t max;
+	uint32_t default_value;
+} ParamInfo_t;
+
+/** Saved parameters, in the last flash page. */
+#define PARAM_FLASH_MAGIC 		0x50415231U		// "PAR1"
+
+class ParamServer
+{
+private:
+	Params_t _values = PARAM_DEFAULTS;
+
+	typedef struct
+	{
+		uint32_t magic;
+		uint32_t size;
+		Params_t values;
+		uint16_t crc;
+	} ParamRecord_t;
+
+public:
+	// Values read by the drivers, valid for the lifetime of the server
+	const Params_t *values(void) const
+	{
+		return &_values;
+	}
+
+	/**
+	 * @brief Sets a parameter from its raw 4 bytes.
+	 *
+	 * @return uint8_t 1 if the id is known and the value in range, 0 otherwise.
+	 */
+	uint8_t set(uint8_t id, uint32_t raw)
+	{
+		switch(id)
+		{
+#define PARAM_SET(id_enum, id, member, type, min, max, def) \
+			case id_enum: \
+				return set_value(&_values.member, raw, (type)(min), (type)(max));
+
+			PARAM_TABLE(PARAM_SET)
+
+#undef PARAM_SET
+			default:
+				return 0;
+		}
+	}
+
+	// Returns 0 if the id is unknown
+	uint8_t get_info(uint8_t id, ParamInfo_t *info) const
+	{
+		switch(id)
+		{
+#define PARAM_INFO(id_enum, id, member, type, min, max, def) \
+			case id_enum: \
+				*info = ParamInfo_t{id_enum, ParamTypeOf<type>::value, raw(_values.member), raw((type)(min)), \
+														raw((type)(max)), raw((type)(def))}; \
+				return 1;
+
+			PARAM_TABLE(PARAM_INFO)
+
+#undef PARAM_INFO
+			default:
+				return 0;
+		}
+	}
+
+	void reset(void)
+	{
+		_values = PARAM_DEFAULTS;
+	}
+
+#if PARAM_FLASH_PERSISTENCE
+	/**
+	 * @brief Restores the saved values, the parameters not saved or out of range
+	 * keep their default.
+	 *
+	 * @return uint8_t 1 if values were restored.
+	 */
+	uint8_t load(void)
+	{
+		const ParamRecord_t *record = (const ParamRecord_t *)(uintptr_t)flash_address();
+
+		if(record->magic != PARAM_FLASH_MAGIC || record->size != sizeof(Params_t)
+				|| record->crc != crc_finalize(crc_update(crc_init(), &record->values, sizeof(Params_t))))
+		{
+			return 0;
+		}
+
+#define PARAM_LOAD(id_enum, id, member, type, min, max, def) \
+		set(id_enum, raw(record->values.member));
+
+		PARAM_TABLE(PARAM_LOAD)
+
+#undef PARAM_LOAD
+
+		return 1;
+	}
+
+	/**
+	 * @brief Saves the current values to flash.
+	 *
+	 * The page erase stalls the CPU for about 25 ms, don't call during a test.
+	 *
+	 * @return uint8_t 1 on success.
+	 */
+	uint8_t save(void)
+	{
+		// Programmed by double words
+		uint64_t words[(sizeof(ParamRecord_t) + 7) / 8] = {0};
+		ParamRecord_t record = {PARAM_FLASH_MAGIC, sizeof(Params_t), _values, 0};
+		record.crc = crc_finalize(crc_update(crc_init(), &record.values, sizeof(Params_t)));
+		memcpy(words, &record, sizeof(record));
+
+		const uint32_t address = flash_address();
+		FLASH_EraseInitTypeDef erase = {};
+		erase.TypeErase = FLASH_TYPEERASE_PAGES;
+		erase.Banks = FLASH_BANK_2;
+		erase.Page = (address - (FLASH_BASE + FLASH_BANK_SIZE)) / FLASH_PAGE_SIZE;
+		erase.NbPages = 1;
+		uint32_t page_error = 0;
+
+		uint8_t ok = HAL_FLASH_Unlock() == HAL_OK;
+		__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+		ok = ok && HAL_FLASHEx_Erase(&erase, &page_error) == HAL_OK;
+		for(size_t i = 0; ok && i < sizeof(words) / sizeof(words[0]); i++)
+		{
+			ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + 8 * i, words[i]) == HAL_OK;
+		}
+		HAL_FLASH_Lock();
+
+		return ok;
+	}
+
+private:
+	static uint32_t flash_address(void)
+	{
+		return FLASH_BASE + FLASH_SIZE - FLASH_PAGE_SIZE;
+	}
+#endif
+
+private:
+	template<class T> static uint32_t raw(T value)
+	{
+		static_assert(sizeof(T) == sizeof(uint32_t), "Parameters are 4 bytes");
+		uint32_t raw_value;
+		memcpy(&raw_value, &value, sizeof(raw_value));
+		return raw_value;
+	}
+
+	template<class T> static uint8_t set_value(T *value, uint32_t raw_value, T min, T max)
+	{
+		T new_value;
+		memcpy(&new_value, &raw_value, sizeof(new_value));
+
+		// Written so that NaN is out of range
+		if(!(new_value >= min && new_value <= max))
+		{
+			return 0;
+		}
+
+		*value = new_value;
+		return 1;
+	}
+};
@@ -11,10 +11,21 @@
 #include "hx711_driver.hh"
 #include "current_amplifier_ina180.hh"
 #include "ds18b20_driver.hh"
+#include "current_profile_sampler.hh"
 #include "filter.hh"
+#include "param_server.hh"
 
 #define SEN_FB_ADC_NB_CH 4
 
+// Max number of load cell samples reported per control tick
+#define SEN_FB_LOAD_CELL_SAMPLES_MAX 4
+
+// Report the load cell value interpolated onto the control tick instead of the latest sample
+#define SEN_FB_LOAD_CELL_INTERPOLATE 1
+
+// The load_cell_gain parameter holds an HX711Gain_t
+static_assert(HX711_GAIN_A_128 == 25 && HX711_GAIN_B_32 == 26 && HX711_GAIN_A_64 == 27, "PARAM_LOAD_CELL_GAIN range");
+
 typedef enum
 {
 	SEN_FB_ADC_CH_MAG = 0x00U,		// Magnetic position feedback
@@ -23,15 +34,34 @@ typedef enum
 	SEN_FB_ADC_CH_VOL = 0x03U    	// Voltage feedback
 } SenFbAdcChType_t;
 
+#if SEN_FB_ADC_DUAL_MODE
+// ADC2 channels, sampled simultaneously with the ADC1 channel of the same rank
+typedef enum
+{
+	SEN_FB_ADC2_CH_CUR_MAG = 0x00U,		// Current, paired with magnetic position feedback
+	SEN_FB_ADC2_CH_CUR_POT = 0x01U,		// Current, paired with potentiometer position feedback
+	// Rank 0x02 converts the magnetic position feedback while ADC1 converts the current, not read
+	SEN_FB_ADC2_CH_CUR_VOL = 0x03U		// Current, paired with voltage feedback
+} SenFbAdc2ChType_t;
+#endif
+
 typedef struct
 {
 	int32_t load_cell_adc_val;
+	HX711Sample_t load_cell_samples[SEN_FB_LOAD_CELL_SAMPLES_MAX];	// Conversions completed since the last tick
+	uint8_t nb_load_cell_samples = 0;
 	uint16_t pot_feedback_adc_val;
 	uint16_t mag_feedback_adc_val;
 	float supply_current_a;
 	float supply_voltage_v;
+	uint16_t mag_sim_position_adc_val = 0;	// Unfiltered magnetic position feedback
+	uint16_t mag_sim_current_adc_val = 0;		// Current sampled simultaneously with mag_sim_position_adc_val
+	uint16_t pot_sim_current_adc_val = 0;		// Current sampled simultaneously with pot_feedback_adc_val
 	TemperatureMsg_t temperature_degc[ONE_WIRE_SENSORS_MAX];
 	size_t nb_temp_sensors = 0;
+	uint16_t temperature_updated = 0;				// Bit i set if temperature_degc[i] was converted since the last tick
+	CurrentProfile_t current_profile = {};
+	uint8_t current_profile_updated = 0;
 } SensorState_t;
 
 class SensorFeedbackDriver
@@ -39,32 +69,53 @@ class SensorFeedbackDriver
 private:
 
 	// ADC
+#if SEN_FB_ADC_DUAL_MODE
+	uint32_t _adc_buf[SEN_FB_ADC_NB_CH];	// ADC1 in the low half-word, ADC2 in the high half-word
+#else
 	uint16_t _adc_buf[SEN_FB_ADC_NB_CH];
+#endif
 	ADC_HandleTypeDef *_hadcx;
 	uint8_t _adcx_conv_cplt = 0;
 
 	// Filter for servo magnetometer feedback
 	Filter<uint16_t> _mag_fb_filter;
 
+	// Filter window and calibrations
+	const Params_t *_params;
+
 	// Load cell
 	HX711Driver *_load_cell;
 
 	// Temperatures
 	DS18B20Driver *_temp_sensors;
 
+	// PWM synchronous current profile
+	CurrentProfileSampler *_current_profile;
+
 	// State
 	SensorState_t _state;
 
 public:
 	SensorFeedbackDriver(ADC_HandleTypeDef *hadcx, HX711Driver *load_cell,
-											 DS18B20Driver *temp_sensors) :
-			_hadcx(hadcx), _load_cell(load_cell), _temp_sensors(temp_sensors)
+											 DS18B20Driver *temp_sensors,
+											 CurrentProfileSampler *current_profile,
+											 const Params_t *params) :
+			_hadcx(hadcx), _params(params), _load_cell(load_cell), _temp_sensors(temp_sensors),
+			_current_profile(current_profile)
 	{
 	}
 
 	void init(void)
 	{
+#ifdef HX711_RATE_Pin
+		// Otherwise the rate is hardwired on the board
+		_load_cell->set_rate_pin(HX711_RATE_GPIO_Port, HX711_RATE_Pin);
+		_load_cell->set_rate(HX711_RATE_80SPS);
+#endif
+		_load_cell->set_gain((HX711Gain_t)_params->load_cell_gain);
+		_load_cell->start();
 		_load_cell->tare();
+		_current_profile->init();
 	}
 
 	void update(void)
@@ -74,25 +125,47 @@ public:
 		update_mag_feedback_adc_val();
 		update_supply_voltage();
 		update_supply_current();
+		update_simultaneous_samples();
+		update_current_profile();
 		update_temperatures();
 		start_adc();
 	}
 
 	void update_load_cell(void)
 	{
-		// Read load cell
+		// Channel and gain changed by the host, each has its own offset
+		if(_params->load_cell_gain != _load_cell->get_gain())
+		{
+			_load_cell->set_gain((HX711Gain_t)_params->load_cell_gain);
+			_load_cell->tare();
+		}
+
+		// Read every load cell conversion completed since the last tick
+		HX711Sample_t sample;
+		_state.nb_load_cell_samples = 0;
+		while(_load_cell->read_sample(&sample))
+		{
+			if(_state.nb_load_cell_samples < SEN_FB_LOAD_CELL_SAMPLES_MAX)
+			{
+				_state.load_cell_samples[_state.nb_load_cell_samples++] = sample;
+			}
+			_state.load_cell_adc_val = sample.value;
+		}
+
+#if SEN_FB_LOAD_CELL_INTERPOLATE
 		int32_t load_cell_adc_val;
-		if(_load_cell->read(&load_cell_adc_val))
+		if(_load_cell->read_interpolated(&load_cell_adc_val))
 		{
 			_state.load_cell_adc_val = load_cell_adc_val;
 		}
+#endif
 	}
 
 	void update_pot_feedback_adc_val(void)
 	{
 		if(_adcx_conv_cplt)
 		{
-			_state.pot_feedback_adc_val = _adc_buf[SEN_FB_ADC_CH_POT];
+			_state.pot_feedback_adc_val = adc_val(SEN_FB_ADC_CH_POT);
 		}
 	}
 
@@ -100,8 +173,8 @@ public:
 	{
 		if(_adcx_conv_cplt)
 		{
-			_mag_fb_filter.update(_adc_buf[SEN_FB_ADC_CH_MAG]);
-			_state.mag_feedback_adc_val = _mag_fb_filter.apply_mean(16);
+			_mag_fb_filter.update(adc_val(SEN_FB_ADC_CH_MAG));
+			_state.mag_feedback_adc_val = _mag_fb_filter.apply_mean(_params->mag_filter_window);
 		}
 	}
 
@@ -111,31 +184,63 @@ public:
 		{
 			const float Rup = 6.8;
 			const float Rdown = 1;
-			const float calibration_gain = 1.0;
-			const float calibration_offset = 0.44;
 
-			_state.supply_voltage_v = _adc_buf[SEN_FB_ADC_CH_VOL] * 3.3 / 4096 * (Rdown + Rup) / Rdown;
-			_state.supply_voltage_v = _state.supply_voltage_v * calibration_gain + calibration_offset;
+			_state.supply_voltage_v = adc_val(SEN_FB_ADC_CH_VOL) * 3.3 / 4096 * (Rdown + Rup) / Rdown;
+			_state.supply_voltage_v = _state.supply_voltage_v * _params->voltage_gain + _params->voltage_offset_v;
 		}
 	}
 
 	void update_supply_current(void)
 	{
-		const float calibration_gain = 1.03;
-		const float calibration_offset = 0.2;
 		if(_adcx_conv_cplt)
 		{
-			_state.supply_current_a = _adc_buf[SEN_FB_ADC_CH_CUR] * 3.3 / 4096
-					/ INA180_GAIN / INA180_R_SHUNT;
-			_state.supply_current_a = _state.supply_current_a * calibration_gain + calibration_offset;
+			_state.supply_current_a = adc_to_current(adc_val(SEN_FB_ADC_CH_CUR));
+		}
+	}
+
+	void update_simultaneous_samples(void)
+	{
+#if SEN_FB_ADC_DUAL_MODE
+		if(_adcx_conv_cplt)
+		{
+			_state.mag_sim_position_adc_val = adc_val(SEN_FB_ADC_CH_MAG);
+			_state.mag_sim_current_adc_val = adc2_val(SEN_FB_ADC2_CH_CUR_MAG);
+			_state.pot_sim_current_adc_val = adc2_val(SEN_FB_ADC2_CH_CUR_POT);
 		}
+#endif
+	}
+
+	void update_current_profile(void)
+	{
+		_state.current_profile_updated = _current_profile->get_profile(&_state.current_profile);
+	}
+
+	// Sampling points of the current profile, see CurrentProfileSampler::set_offsets()
+	uint8_t set_current_profile_offsets(const uint16_t *offsets_us, uint8_t n_points)
+	{
+		return _current_profile->set_offsets(offsets_us, n_points);
+	}
+
+	float adc_to_current(uint16_t adc_val)
+	{
+		float current_a = adc_val * 3.3 / 4096 / INA180_GAIN / INA180_R_SHUNT;
+		return current_a * _params->current_gain + _params->current_offset_a;
 	}
 
 	void update_temperatures(void)
 	{
-		_state.temperature_degc[0].temp = _temp_sensors->read_temperature_single();
-		_state.nb_temp_sensors = 1;
+		// Non-blocking, the conversions run in the sensors between ticks
+		_temp_sensors->update();
 
+		_state.nb_temp_sensors = _temp_sensors->get_device_count();
+		_state.temperature_updated = _temp_sensors->get_updated();
+		for(size_t i = 0; i < _state.nb_temp_sensors; i++)
+		{
+			if(_state.temperature_updated & (1 << i))
+			{
+				_state.temperature_degc[i] = _temp_sensors->get_temperature(i);
+			}
+		}
 	}
 
 	// Getters
@@ -148,9 +253,28 @@ public:
 	uint8_t start_adc(void)
 	{
 		_adcx_conv_cplt = 0;
+#if SEN_FB_ADC_DUAL_MODE
+		return (HAL_ADCEx_MultiModeStart_DMA(_hadcx, _adc_buf, SEN_FB_ADC_NB_CH)
+				== HAL_OK);
+#else
 		return (HAL_ADC_Start_DMA(_hadcx, (uint32_t*)_adc_buf, SEN_FB_ADC_NB_CH)
 				== HAL_OK);
+#endif
+	}
+
+	// ADC1 result of the given rank
+	uint16_t adc_val(SenFbAdcChType_t ch)
+	{
+		return (uint16_t)(_adc_buf[ch] & MAX_UINT16_T);
+	}
+
+#if SEN_FB_ADC_DUAL_MODE
+	// ADC2 result of the given rank
+	uint16_t adc2_val(SenFbAdc2ChType_t ch)
+	{
+		return (uint16_t)(_adc_buf[ch] >> 16);
 	}
+#endif
 
 	ADC_TypeDef* get_adc_instance(void)
 	{
@@ -161,6 +285,11 @@ public:
 	{
 		_adcx_conv_cplt = 1;
 	}
+
+	void on_adc_injected_cplt_conv(void)
+	{
+		_current_profile->on_injected_conv_cplt();
+	}
 };
 
 #endif /* DRIVERS_INC_SENSOR_FEEDBACK_DRIVER_HH_ */
@@ -11,177 +11,218 @@
 #include <string.h>
 
 #include "main.h"
+#include "DeviceInterfaces.hh"
 #include "StreamInterface.hh"
+#include "CircularBuffer.hh"
+#include "Framing.hh"
+#include "MinHeap.hh"
+#include "si_commands.hh"
+
+// Command frames are the command code, the host sequence number (uint16_t) and the payload,
+// framed like telemetry messages (Framing.hh). If SI_CMD_FLAG_SCHEDULED is set in the code,
+// the sequence number is followed by the execution time (uint32_t, device time in us).
+#define SI_CMD_BUFFER_SIZE 40
+#define SI_CMD_PAYLOAD_OFFSET 3
+#define SI_CMD_FLAG_SCHEDULED 0x80
+
+static_assert(SI_CMD_PAYLOAD_OFFSET + sizeof(uint32_t) + si_cmd_max_payload_size() <= SI_CMD_BUFFER_SIZE,
+							"Command payload too large");
+static_assert(CMD_ENUM_MAX <= SI_CMD_FLAG_SCHEDULED, "Command codes overlap the scheduled flag");
+
+// Number of decoded commands waiting to be read (power of two)
+#define SI_CMD_QUEUE_SIZE 8
+
+// Number of commands waiting for their execution time
+#define SI_CMD_SCHEDULE_SIZE 16
 
-typedef enum
+// Command code, sequence number and payload
+typedef struct
 {
-	CMD_NO_CMD										= 0x00,
-	CMD_SERVO_STOP								= 0x01,
-	CMD_SERVO_SET_ANGLE 					= 0x02,
-	CMD_SERVO_START_SIN 					= 0x03,
-	CMD_SERVO_START_TRAP					= 0x04,
-	CMD_SERVO_START_SIN_SWEEP 		= 0x05,
-	CMD_SERVO_START_TRAP_SWEEP		= 0x06,
-	CMD_ENUM_MAX									= 0x07,
-} SiCmd_t;
-
-#define SI_CMD_HEADER 0xAB
-#define SI_CMD_BUFFER_SIZE 40
+	uint8_t buf[SI_CMD_BUFFER_SIZE];
+	uint32_t received_us;
+	uint32_t execute_us;
+	bool scheduled;
+} SiCommand_t;
+
+// Orders scheduled commands by execution time, the device time wrapping around
+struct SiCmdExecutesBefore
+{
+	bool operator()(const SiCommand_t &a, const SiCommand_t &b) const
+	{
+		return (int32_t)(a.execute_us - b.execute_us) < 0;
+	}
+};
 
 class SerialInterface
 {
 private:
 	StreamInterface 	*_stream;
+	const TimeSourceInterface *_time_source;
 	uint8_t 		_cmd_buf[SI_CMD_BUFFER_SIZE] = {0};
+	uint32_t 		_cmd_received_us = 0;
+
+	// Decodes the frames as their bytes leave the receive buffer, kept across calls so that
+	// frames may arrive in pieces
+	FrameDecoder<SI_CMD_BUFFER_SIZE> _decoder;
+
+	// Complete commands, in order of arrival
+	CircularBuffer<SiCommand_t, SI_CMD_QUEUE_SIZE> _commands;
+
+	// Scheduled commands, earliest execution time on top
+	MinHeap<SiCommand_t, SI_CMD_SCHEDULE_SIZE, SiCmdExecutesBefore> _schedule;
+	bool _cmd_scheduled = false;
+	bool _cmd_schedule_full = false;
+
+	uint32_t _dropped_commands = 0;
+	uint32_t _invalid_frames = 0;
 
 public:
-	SerialInterface(StreamInterface *stream) : _stream(stream)
+	SerialInterface(StreamInterface *stream, const TimeSourceInterface *time_source = nullptr) :
+			_stream(stream), _time_source(time_source)
 	{
 	}
 
-	SiCmd_t read(void)
+	/**
+	 * @brief Parses the received bytes and returns the next command to execute at now_us.
+	 *
+	 * Call until CMD_NO_CMD is returned to handle every command due. Scheduled
+	 * commands are held until now_us reaches their execution time, then returned
+	 * before the immediate ones. The parameters of the returned command are read
+	 * with get_payload().
+	 */
+	SiCmd_t read(uint32_t now_us)
 	{
-    // Was message header detected
-		uint8_t header_found = 0;
+		parse();
 
-    // Command buffer index
-    size_t i = 0;
+		SiCommand_t cmd;
+		while(true)
+		{
+			if(!_schedule.empty() && (int32_t)(_schedule.top().execute_us - now_us) <= 0)
+			{
+				_schedule.pop(&cmd);
+				return load_command(cmd, false);
+			}
 
-    // Message payload
-    size_t payload;
+			if(!_commands.get(&cmd))
+			{
+				return CMD_NO_CMD;
+			}
 
-		while(_stream->available())
-		{
-			// Read next byte
-			uint8_t byte = _stream->read();
+			if(!cmd.scheduled || (int32_t)(cmd.execute_us - now_us) <= 0)
+			{
+				return load_command(cmd, false);
+			}
 
-			// Look for start header
-			if(!header_found)
+			if(!_schedule.push(cmd))
 			{
-				if(byte == SI_CMD_HEADER)
-				{
-					header_found = 1;
-				}
+				// Returned right away for its rejection to be acknowledged
+				return load_command(cmd, true);
 			}
-			else
+		}
+	}
+
+	// Consumes every received byte, complete commands are queued and timestamped. May be
+	// called more often than read() for accurate receive timestamps.
+	void parse(void)
+	{
+		while(_stream->available())
+		{
+			if(_decoder.put(_stream->read()))
 			{
-				// Process command byte
-				if(i == 0)
-				{
-					if(cmd_valid(byte))
-					{
-						payload = get_payload_from_cmd(byte);
-						_cmd_buf[i++] = byte;
-					}
-					else
-					{
-						return CMD_NO_CMD;
-					}
-				}
-				else
-				{
-					if(i == payload + 1)
-					{
-						if(byte == calculate_checksum(_cmd_buf, payload + 1))
-						{
-							return (SiCmd_t)_cmd_buf[0];
-						}
-						else
-						{
-							return CMD_NO_CMD;
-						}
-					}
-					else
-					{
-						_cmd_buf[i++] = byte;
-					}
-				}
+				queue_command(_decoder.data(), _decoder.length());
 			}
 		}
-		return CMD_NO_CMD;
 	}
 
-	void get_sin_params(float *angle_min_deg, float *angle_max_deg, float *period_s)
+	// Host sequence number of the last command returned by read()
+	uint16_t get_sequence(void) const
 	{
-		memcpy((void *)angle_min_deg, (void *)&_cmd_buf[1], sizeof(float));
-		memcpy((void *)angle_max_deg, (void *)&_cmd_buf[5], sizeof(float));
-		memcpy((void *)period_s, (void *)&_cmd_buf[9], sizeof(float));
+		return (uint16_t)(_cmd_buf[1] | (_cmd_buf[2] << 8));
 	}
 
-	void get_sin_sweep_params(
-		float *angle_min_deg,
-		float *angle_max_deg,
-		float *period_min_s,
-		float *period_max_s,
-		uint32_t *n_periods,
-		uint32_t *n_cycles_per_period
-	)
+	// Time at which the last command returned by read() was decoded
+	uint32_t get_received_us(void) const
 	{
-		memcpy((void *)angle_min_deg, (void *)&_cmd_buf[1], sizeof(float));
-		memcpy((void *)angle_max_deg, (void *)&_cmd_buf[5], sizeof(float));
-		memcpy((void *)period_min_s, (void *)&_cmd_buf[9], sizeof(float));
-		memcpy((void *)period_max_s, (void *)&_cmd_buf[13], sizeof(float));
-		memcpy((void *)n_periods, (void *)&_cmd_buf[17], sizeof(uint32_t));
-		memcpy((void *)n_cycles_per_period, (void *)&_cmd_buf[21], sizeof(uint32_t));
+		return _cmd_received_us;
 	}
 
-	void get_trap_params(float *angle_min_deg, float *angle_max_deg, float *period_s, float *plateau_time_s)
+	// True if the last command returned by read() carried an execution time
+	bool is_scheduled(void) const
 	{
-		memcpy((void *)angle_min_deg, (void *)&_cmd_buf[1], sizeof(float));
-		memcpy((void *)angle_max_deg, (void *)&_cmd_buf[5], sizeof(float));
-		memcpy((void *)period_s, (void *)&_cmd_buf[9], sizeof(float));
-		memcpy((void *)plateau_time_s, (void *)&_cmd_buf[13], sizeof(float));
+		return _cmd_scheduled;
 	}
 
-	void get_target_angle(float *angle_deg)
+	// True if the last command returned by read() was scheduled while the schedule was full,
+	// it must then be rejected rather than executed
+	bool schedule_full(void) const
 	{
-		memcpy((void *)angle_deg, (void *)&_cmd_buf[1], sizeof(float));
+		return _cmd_schedule_full;
 	}
 
+	// Drops the scheduled commands that haven't been executed yet
+	void clear_schedule(void)
+	{
+		_schedule.clear();
+	}
 
+	uint32_t get_dropped_commands(void) const
+	{
+		return _dropped_commands;
+	}
 
-private:
-	uint8_t cmd_valid(uint8_t byte)
+	uint32_t get_invalid_frames(void) const
 	{
-		if(byte < CMD_ENUM_MAX)
-		{
-			return 1;
-		}
-		else
-		{
-			return 0;
-		}
+		return _invalid_frames + _decoder.get_invalid_frames();
+	}
+
+	// Payload of the last command returned by read(), Code being its code
+	template<SiCmd_t Code> typename SiCmdPayload<Code>::type get_payload(void) const
+	{
+		typename SiCmdPayload<Code>::type payload;
+		memcpy((void *)&payload, (const void *)&_cmd_buf[SI_CMD_PAYLOAD_OFFSET], sizeof(payload));
+		return payload;
 	}
 
 private:
-	size_t get_payload_from_cmd(uint8_t cmd)
+	SiCmd_t load_command(const SiCommand_t &cmd, bool schedule_full)
 	{
-		switch(cmd)
-		{
-			case CMD_SERVO_SET_ANGLE:
-				return 1 * sizeof(float);
-			case CMD_SERVO_START_SIN:
-				return 3 * sizeof(float);
-			case CMD_SERVO_START_TRAP:
-				return 4 * sizeof(float);
-			case CMD_SERVO_START_SIN_SWEEP:
-				return 5 * sizeof(float) + 1 * sizeof(uint32_t);
-			case CMD_SERVO_STOP:
-				return 0;
-			default:
-				return 0;
-		}
+		memcpy(_cmd_buf, cmd.buf, sizeof(_cmd_buf));
+		_cmd_received_us = cmd.received_us;
+		_cmd_scheduled = cmd.scheduled;
+		_cmd_schedule_full = schedule_full;
+
+		return (SiCmd_t)_cmd_buf[0];
 	}
 
 private:
-	uint8_t calculate_checksum(uint8_t *msg, size_t msg_len)
+	// Queues a decoded message if it is a known command with the expected payload length
+	void queue_command(const uint8_t *msg, size_t len)
 	{
-		uint32_t sum = 0;
-		for(size_t i = 0; i < msg_len; i++)
+		const bool scheduled = len > 0 && (msg[0] & SI_CMD_FLAG_SCHEDULED);
+		const size_t header_size = SI_CMD_PAYLOAD_OFFSET + (scheduled ? sizeof(uint32_t) : 0);
+		const int payload_size = len > 0 ? si_cmd_payload_size(msg[0] & ~SI_CMD_FLAG_SCHEDULED) : -1;
+		if(payload_size < 0 || len != (size_t)payload_size + header_size)
+		{
+			_invalid_frames++;
+			return;
+		}
+
+		// Stored without the execution time, the payload always at SI_CMD_PAYLOAD_OFFSET
+		SiCommand_t cmd = {};
+		cmd.buf[0] = msg[0] & ~SI_CMD_FLAG_SCHEDULED;
+		memcpy(&cmd.buf[1], &msg[1], SI_CMD_PAYLOAD_OFFSET - 1);
+		memcpy(&cmd.buf[SI_CMD_PAYLOAD_OFFSET], &msg[header_size], payload_size);
+		cmd.scheduled = scheduled;
+		if(scheduled)
+		{
+			memcpy(&cmd.execute_us, &msg[SI_CMD_PAYLOAD_OFFSET], sizeof(uint32_t));
+		}
+		cmd.received_us = _time_source != nullptr ? _time_source->now_micros() : 0;
+
+		if(!_commands.put(cmd))
 		{
-			sum += msg[i];
+			_dropped_commands++;
 		}
-		return (uint8_t)(sum & 0xFF);
 	}
 };
 
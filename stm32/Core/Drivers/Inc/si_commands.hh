@@ -0,0 +1,190 @@
+/**
+ * @file    si_commands.hh
+ * @brief   Command set of the host link.
+ *
+ * Each command is one entry of SI_COMMAND_TABLE: its code, its name and the
+ * type of its payload. The table generates the SiCmd_t codes, the payload
+ * sizes checked by SerialInterface and the dispatch table of ServoController,
+ * which handles a command in its on_<name>() member. The host encoders
+ * (python/si_commands.py) are generated from this file by
+ * python/gen_commands.py, which reads the table, the payload structs and the
+ * enum values: keep one entry per line, the payload fields as "type name;" and
+ * the enum values as "NAME = 0x..".
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Outcome of a command, reported in its acknowledgement
+typedef enum
+{
+	CMD_STATUS_OK									= 0x00,
+	CMD_STATUS_REJECTED						= 0x01,		// Invalid parameters
+	CMD_STATUS_UNSUPPORTED				= 0x02,
+	CMD_STATUS_SCHEDULE_FULL			= 0x03,		// Too many scheduled commands pending
+} SiCmdStatus_t;
+
+// Steps of a test plan (CMD_PLAN_ADD_STEP), transitions happen on control steps
+typedef enum
+{
+	PLAN_STEP_SET_ANGLE						= 0x00,		// Sets the angle value_0 (deg)
+	PLAN_STEP_SINE								= 0x01,		// Sinusoid between value_0 and value_1 (deg) of period value_2 (s), for duration_ms
+	PLAN_STEP_SWEEP								= 0x02,		// Sweep as CMD_SERVO_START_SIN_SWEEP (values then counts), until its end
+	PLAN_STEP_HOLD								= 0x03,		// Holds the current angle for duration_ms
+	PLAN_STEP_WAIT								= 0x04,		// Holds until condition count_0 with threshold value_0, aborts after duration_ms (0: no timeout)
+	PLAN_STEP_LOOP								= 0x05,		// Jumps back to step count_0, count_1 times
+	PLAN_STEP_TYPE_MAX,
+} PlanStepType_t;
+
+// Conditions of PLAN_STEP_WAIT
+typedef enum
+{
+	PLAN_COND_TEMPERATURE_BELOW		= 0x00,		// Every temperature sensor below value_0 (degC)
+	PLAN_COND_TEMPERATURE_ABOVE		= 0x01,		// Any temperature sensor above value_0 (degC)
+	PLAN_COND_CURRENT_BELOW				= 0x02,		// Supply current below value_0 (A)
+	PLAN_COND_MAX,
+} PlanCondition_t;
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+} SiNoPayload_t;
+
+typedef struct
+{
+	float angle_deg;
+} SiSetAngle_t;
+
+typedef struct
+{
+	float angle_min_deg;
+	float angle_max_deg;
+	float period_s;
+} SiSinusoid_t;
+
+typedef struct
+{
+	float angle_min_deg;
+	float angle_max_deg;
+	float period_min_s;
+	float period_max_s;
+	uint32_t n_periods;
+	uint32_t n_cycles_per_period;
+} SiSinusoidSweep_t;
+
+typedef struct
+{
+	uint32_t baudrate;
+} SiSetBaudrate_t;
+
+typedef struct
+{
+	uint8_t index;
+	uint8_t type;
+	float value_0;
+	float value_1;
+	float value_2;
+	float value_3;
+	uint32_t duration_ms;
+	uint32_t count_0;
+	uint32_t count_1;
+} SiPlanStep_t;
+
+typedef struct
+{
+	uint8_t id;
+} SiParamId_t;
+
+typedef struct
+{
+	uint8_t id;
+	uint32_t value;		// Raw 4 bytes of the value, of the type of the parameter
+} SiParamSet_t;
+
+// Offsets from the start of the PWM frame, strictly ascending, the first n_points are used
+typedef struct
+{
+	uint8_t n_points;
+	uint16_t offset_0_us;
+	uint16_t offset_1_us;
+	uint16_t offset_2_us;
+	uint16_t offset_3_us;
+	uint16_t offset_4_us;
+	uint16_t offset_5_us;
+	uint16_t offset_6_us;
+	uint16_t offset_7_us;
+} SiCurrentProfileOffsets_t;
+
+#pragma pack(pop)
+
+// X(code enumerator, code, name, payload type)
+// Codes 0x04 and 0x06 are reserved for the trapezoidal trajectories.
+#define SI_COMMAND_TABLE(X) \
+	X(CMD_SERVO_STOP,							0x01, servo_stop,							SiNoPayload_t) \
+	X(CMD_SERVO_SET_ANGLE,				0x02, servo_set_angle,				SiSetAngle_t) \
+	X(CMD_SERVO_START_SIN,				0x03, servo_start_sin,				SiSinusoid_t) \
+	X(CMD_SERVO_START_SIN_SWEEP,	0x05, servo_start_sin_sweep,	SiSinusoidSweep_t) \
+	X(CMD_SERIAL_SET_BAUDRATE,		0x07, serial_set_baudrate,		SiSetBaudrate_t) \
+	X(CMD_SERIAL_PING,						0x08, serial_ping,						SiNoPayload_t) \
+	X(CMD_PLAN_CLEAR,							0x09, plan_clear,							SiNoPayload_t) \
+	X(CMD_PLAN_ADD_STEP,					0x0A, plan_add_step,					SiPlanStep_t) \
+	X(CMD_PLAN_START,							0x0B, plan_start,							SiNoPayload_t) \
+	X(CMD_PARAM_GET,							0x0C, param_get,							SiParamId_t) \
+	X(CMD_PARAM_SET,							0x0D, param_set,							SiParamSet_t) \
+	X(CMD_PARAM_LIST,							0x0E, param_list,							SiNoPayload_t) \
+	X(CMD_PARAM_SAVE,							0x0F, param_save,							SiNoPayload_t) \
+	X(CMD_PARAM_RESET,						0x10, param_reset,						SiNoPayload_t) \
+	X(CMD_CURRENT_PROFILE_OFFSETS,	0x11, current_profile_offsets,	SiCurrentProfileOffsets_t)
+
+#define SI_CMD_ENUM(code_enum, code, name, payload) code_enum = code,
+
+typedef enum
+{
+	CMD_NO_CMD = 0x00,
+	SI_COMMAND_TABLE(SI_CMD_ENUM)
+	CMD_ENUM_MAX,
+} SiCmd_t;
+
+#undef SI_CMD_ENUM
+
+// Payload type of a command, SiCmdPayload<CMD_...>::type
+template<SiCmd_t Code> struct SiCmdPayload;
+
+#define SI_CMD_PAYLOAD(code_enum, code, name, payload) \
+	template<> struct SiCmdPayload<code_enum> { typedef payload type; };
+
+SI_COMMAND_TABLE(SI_CMD_PAYLOAD)
+
+#undef SI_CMD_PAYLOAD
+
+// Payload size of a command code, -1 if the code is unknown
+constexpr int si_cmd_payload_size(uint8_t code)
+{
+	switch(code)
+	{
+#define SI_CMD_PAYLOAD_SIZE(code_enum, code, name, payload) \
+		case code_enum: \
+			return std::is_empty<payload>::value ? 0 : (int)sizeof(payload);
+
+		SI_COMMAND_TABLE(SI_CMD_PAYLOAD_SIZE)
+
+#undef SI_CMD_PAYLOAD_SIZE
+		default:
+			return -1;
+	}
+}
+
+// Size of the largest payload
+constexpr size_t si_cmd_max_payload_size(void)
+{
+	int size = 0;
+	for(int code = 0; code < CMD_ENUM_MAX; code++)
+	{
+		size = si_cmd_payload_size((uint8_t)code) > size ? si_cmd_payload_size((uint8_t)code) : size;
+	}
+	return (size_t)size;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file    test_plan.hh
+ * @brief   Test plan stored in RAM and run by the controller without the host.
+ *
+ * The host uploads the steps in order (CMD_PLAN_CLEAR, CMD_PLAN_ADD_STEP) then
+ * starts the plan (CMD_PLAN_START). This class holds the steps and the cursor
+ * of the running plan: the current step, the control steps spent in it and
+ * the iterations of the loops. Executing a step is left to ServoController,
+ * which calls next() once the current step is complete, on a control step.
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include "si_commands.hh"
+
+/** Max number of steps of a plan. */
+#define TEST_PLAN_MAX_STEPS 	64U
+
+class TestPlan
+{
+private:
+	SiPlanStep_t _steps[TEST_PLAN_MAX_STEPS];
+	uint8_t _nb_steps = 0;
+
+	// Jumps done by each loop step since it was last entered from before its target
+	uint32_t _loop_counts[TEST_PLAN_MAX_STEPS] = {0};
+	uint32_t _loops = 0;
+
+	uint8_t _running = 0;
+	uint8_t _current = 0;
+	uint32_t _step_ticks = 0;
+
+public:
+	void clear(void)
+	{
+		_running = 0;
+		_nb_steps = 0;
+	}
+
+	/**
+	 * @brief Appends a step, or replaces a step already uploaded.
+	 *
+	 * @return uint8_t 1 if the step is valid, 0 otherwise. Steps can't be changed
+	 * while the plan runs.
+	 */
+	uint8_t add_step(const SiPlanStep_t &step)
+	{
+		if(_running || step.index > _nb_steps || step.index >= TEST_PLAN_MAX_STEPS
+				|| step.type >= PLAN_STEP_TYPE_MAX)
+		{
+			return 0;
+		}
+
+		// Loops jump backwards only, so every loop ends
+		if(step.type == PLAN_STEP_LOOP && step.count_0 >= step.index)
+		{
+			return 0;
+		}
+
+		if(step.type == PLAN_STEP_WAIT && step.count_0 >= PLAN_COND_MAX)
+		{
+			return 0;
+		}
+
+		_steps[step.index] = step;
+		if(step.index == _nb_steps)
+		{
+			_nb_steps++;
+		}
+
+		return 1;
+	}
+
+	/**
+	 * @brief Starts the plan from its first step.
+	 *
+	 * @return uint8_t 0 if the plan is empty or starts with a loop.
+	 */
+	uint8_t start(void)
+	{
+		if(_nb_steps == 0 || _steps[0].type == PLAN_STEP_LOOP)
+		{
+			return 0;
+		}
+
+		memset(_loop_counts, 0, sizeof(_loop_counts));
+		_loops = 0;
+		_current = 0;
+		_step_ticks = 0;
+		_running = 1;
+
+		return 1;
+	}
+
+	void abort(void)
+	{
+		_running = 0;
+	}
+
+	/**
+	 * @brief Moves to the next step to execute, following the loops.
+	 *
+	 * @return uint8_t 0 if the plan is finished, the current step is then the last
+	 * step executed.
+	 */
+	uint8_t next(void)
+	{
+		const uint8_t last = _current;
+
+		_current++;
+		_step_ticks = 0;
+
+		while(_current < _nb_steps && _steps[_current].type == PLAN_STEP_LOOP)
+		{
+			const SiPlanStep_t &loop = _steps[_current];
+
+			if(_loop_counts[_current] < loop.count_1)
+			{
+				_loop_counts[_current]++;
+				_loops++;
+
+				// Loops nested in the body start over
+				for(size_t i = loop.count_0; i < _current; i++)
+				{
+					_loop_counts[i] = 0;
+				}
+				_current = (uint8_t)loop.count_0;
+			}
+			else
+			{
+				_current++;
+			}
+		}
+
+		if(_current >= _nb_steps)
+		{
+			_current = last;
+			_running = 0;
+		}
+
+		return _running;
+	}
+
+	// Called on every control step while the plan runs
+	void tick(void)
+	{
+		_step_ticks++;
+	}
+
+	uint8_t is_running(void) const
+	{
+		return _running;
+	}
+
+	uint8_t get_index(void) const
+	{
+		return _current;
+	}
+
+	const SiPlanStep_t &get_step(void) const
+	{
+		return _steps[_current];
+	}
+
+	// Control steps spent in the current step
+	uint32_t get_step_ticks(void) const
+	{
+		return _step_ticks;
+	}
+
+	// Loop jumps since the start of the plan
+	uint32_t get_loops(void) const
+	{
+		return _loops;
+	}
+};
@@ -12,15 +12,104 @@ class UartDriver : public StreamInterface
   private:
     UART_HandleTypeDef *_huartx;
   private:
-    CircularBuffer<uint8_t, 300> _read_buf;
+    static constexpr size_t ReadBufSize = 256;
   private:
-    uint8_t _read_byte;
+    // Written by the circular receive DMA, read in place
+    uint8_t _read_buf[ReadBufSize];
   private:
-    CircularBuffer<uint8_t, 600> _write_buf;
+    // Bytes received and read since the reception started, wrapping around. The DMA position
+    // in _read_buf is _read_head % ReadBufSize, advanced on idle-line, half and full transfer
+    // events.
+    volatile size_t _read_head = 0;
   private:
-    uint8_t _write_chunk[30];
+    size_t _read_tail = 0;
   private:
-    bool _is_writing = false;
+    // Times the DMA overwrote bytes not read yet
+    uint32_t _read_overruns = 0;
+  private:
+    // Set when the reception restarted, read() then returns a framing byte first
+    volatile bool _read_resync = false;
+
+    static_assert((ReadBufSize & (ReadBufSize - 1)) == 0, "Byte counts must wrap around with the buffer");
+  private:
+    static constexpr size_t WriteBufSize = 1024;
+  private:
+    using WriteBuffer = CircularBuffer<uint8_t, WriteBufSize>;
+
+  private:
+    // Transmit stream bound to one lane of the driver.
+    class Lane : public StreamInterface
+    {
+      private:
+        UartDriver *_uart;
+        StreamLane  _lane;
+
+      public:
+        Lane(UartDriver *uart, StreamLane lane) : _uart(uart), _lane(lane) {}
+
+      public:
+        size_t available() const override
+        {
+          return _uart->available();
+        }
+
+      public:
+        uint8_t read() override
+        {
+          return _uart->read();
+        }
+
+      public:
+        size_t write(const uint8_t *buf, size_t len) override
+        {
+          return _uart->write(_lane, buf, len);
+        }
+
+      public:
+        size_t write(const ConstSpan *spans, size_t count) override
+        {
+          return _uart->write(_lane, spans, count);
+        }
+
+      public:
+        size_t reserve(MutableSpan spans[2], size_t len) override
+        {
+          return _uart->reserve(_lane, spans, len);
+        }
+
+      public:
+        void commit(size_t len) override
+        {
+          _uart->commit(_lane, len);
+        }
+
+      public:
+        bool get_stats(StreamLane lane, StreamStats *stats) const override
+        {
+          return _uart->get_stats(lane, stats);
+        }
+    };
+
+  private:
+    // One transmit ring per lane, indexed by StreamLane
+    WriteBuffer _write_bufs[StreamLaneCount];
+  private:
+    StreamStats _write_stats[StreamLaneCount] = {};
+  private:
+    Lane _lanes[StreamLaneCount];
+  private:
+    // Lane and number of bytes being sent by DMA
+    size_t _write_lane = 0;
+    size_t _write_len  = 0;
+  private:
+    // Set when the chunk being sent may end in the middle of a message
+    bool _write_lane_locked = false;
+  private:
+    // Cleared by the TX complete interrupt
+    volatile bool _is_writing = false;
+  private:
+    // Rate to switch to once the message being sent is complete, 0 if none
+    volatile uint32_t _pending_baudrate = 0;
 
   private:
     const uint32_t WriteTimeout = 1000;
@@ -28,12 +117,20 @@ class UartDriver : public StreamInterface
     const uint32_t ReadTimeout = 1000;
 
   public:
-    UartDriver(UART_HandleTypeDef *huartx) : _huartx(huartx) {}
+    UartDriver(UART_HandleTypeDef *huartx)
+        : _huartx(huartx),
+          _lanes {{this, StreamLane::Control}, {this, StreamLane::Telemetry}, {this, StreamLane::Bulk}}
+    {
+    }
 
   private:
     void write_raw(const uint8_t *TxBuffer, size_t Size)
     {
-      if (HAL_UART_Transmit_IT(_huartx, (uint8_t *)TxBuffer, Size) != HAL_OK)
+      // Sent by interrupt if no transmit DMA channel is linked to the UART
+      const HAL_StatusTypeDef status = _huartx->hdmatx != NULL
+                                           ? HAL_UART_Transmit_DMA(_huartx, (uint8_t *)TxBuffer, Size)
+                                           : HAL_UART_Transmit_IT(_huartx, (uint8_t *)TxBuffer, Size);
+      if (status != HAL_OK)
       {
         Error_Handler();
       }
@@ -42,7 +139,12 @@ class UartDriver : public StreamInterface
   public:
     void start()
     {
-      if (HAL_UART_Receive_DMA(_huartx, &_read_byte, 1) != HAL_OK)
+      _read_head   = 0;
+      _read_tail   = 0;
+      _read_resync = true;
+
+      // Circular DMA, keeps receiving until stopped
+      if (HAL_UARTEx_ReceiveToIdle_DMA(_huartx, _read_buf, ReadBufSize) != HAL_OK)
       {
         Error_Handler();
       }
@@ -69,13 +171,76 @@ class UartDriver : public StreamInterface
   public:
     void restart()
     {
+      HAL_UART_AbortReceive(_huartx);
       __HAL_UART_SEND_REQ(_huartx, UART_RXDATA_FLUSH_REQUEST);
-      if (HAL_UART_Receive_DMA(_huartx, &_read_byte, 1) != HAL_OK)
+
+      _read_head   = 0;
+      _read_tail   = 0;
+      _read_resync = true;
+
+      if (HAL_UARTEx_ReceiveToIdle_DMA(_huartx, _read_buf, ReadBufSize) != HAL_OK)
       {
         // Error_Handler();
       }
     }
 
+  public:
+    // Rate in use, or being switched to
+    uint32_t get_baudrate() const
+    {
+      const uint32_t pending = _pending_baudrate;
+
+      return pending != 0 ? pending : _huartx->Init.BaudRate;
+    }
+
+  public:
+    // Switches the baud rate once the message being sent is complete: right away if the link is
+    // idle, otherwise the TX complete interrupt holds the transmission at the end of the message
+    // and update() applies the switch. The enqueued bytes are then sent at the new rate. The
+    // reception restarts, the bytes not read yet are dropped.
+    void set_baudrate(uint32_t baudrate)
+    {
+      __disable_irq();
+      _pending_baudrate = baudrate;
+      const bool idle   = !_is_writing;
+      __enable_irq();
+
+      if (idle)
+      {
+        apply_baudrate();
+      }
+    }
+
+  public:
+    // Called periodically from the main loop, applies a baud rate switch held by the TX
+    // complete interrupt.
+    void update()
+    {
+      if (_pending_baudrate != 0 && !_is_writing)
+      {
+        apply_baudrate();
+      }
+    }
+
+  private:
+    void apply_baudrate()
+    {
+      // Stops the receive DMA, the peripheral is then reconfigured without MSP init
+      HAL_UART_Abort(_huartx);
+
+      _huartx->Init.BaudRate = _pending_baudrate;
+      if (HAL_UART_Init(_huartx) != HAL_OK)
+      {
+        Error_Handler();
+      }
+      _pending_baudrate = 0;
+
+      start();
+
+      // Resume the transmission held for the switch
+      kick();
+    }
+
   public:
     uint32_t get_error()
     {
@@ -112,79 +277,245 @@ class UartDriver : public StreamInterface
     }
 
   public:
-    void on_rx_completed()
+    // Called on idle-line, half and full transfer events, pos is the DMA position in _read_buf.
+    // The half and full transfer events ensure the DMA never moves a whole buffer between two
+    // calls.
+    void on_rx_event(uint16_t pos)
+    {
+      const size_t head = _read_head;
+      _read_head        = head + (pos - head) % ReadBufSize;
+    }
+
+  public:
+    uint32_t get_read_overruns() const
+    {
+      return _read_overruns;
+    }
+
+  public:
+    void on_error()
     {
-      _read_buf.put(_read_byte);
+      // Blocking errors (e.g. overrun) abort the reception
+      if (_huartx->RxState == HAL_UART_STATE_READY)
+      {
+        restart();
+      }
     }
 
   public:
     void on_tx_completed()
     {
+      // The sent bytes can now be overwritten
+      _write_bufs[_write_lane].skip(_write_len);
+      _write_len = 0;
+
       write_next_chunk();
     }
 
   public:
     void write_next_chunk()
     {
-      size_t next_chunk_size = math::min(sizeof(_write_chunk), _write_buf.size());
+      // Lanes are arbitrated at message boundaries only: a chunk that stopped at the end
+      // of its ring with bytes left may have split a message, the lane then keeps the link.
+      if (!_write_lane_locked)
+      {
+        // At a message boundary, hold the transmission until update() switches the rate
+        if (_pending_baudrate != 0)
+        {
+          _is_writing = false;
+          return;
+        }
+
+        _write_lane = 0;
+        while (_write_lane < StreamLaneCount && _write_bufs[_write_lane].empty())
+        {
+          ++_write_lane;
+        }
+
+        if (_write_lane == StreamLaneCount)
+        {
+          _write_lane = 0;
+          _is_writing = false;
+          return;
+        }
+      }
+
+      // Send the contiguous region at the tail straight from the buffer, a wrapped
+      // region goes out as a second transfer.
+      const uint8_t *next_chunk;
+      size_t next_chunk_size = _write_bufs[_write_lane].peek_contiguous(&next_chunk);
+
+      _is_writing        = true;
+      _write_len         = next_chunk_size;
+      _write_lane_locked = next_chunk_size < _write_bufs[_write_lane].size();
+
+      write_raw(next_chunk, next_chunk_size);
+    }
 
-      if (next_chunk_size == 0)
+  private:
+    // Starts sending the enqueued bytes unless a transfer is already running.
+    void kick()
+    {
+      // The TX complete interrupt must not end the current transfer in between
+      __disable_irq();
+      if (!_is_writing)
       {
-        _is_writing = false;
-        return;
+        write_next_chunk();
       }
+      __enable_irq();
+    }
 
-      // Fetch the data from the circular buffer into a linear chunk buffer.
-      // TODO: Optimize CircularBuffer for bulk gets.
-      /*for (size_t i = 0; i < next_chunk_size; ++i)
+  private:
+    void enqueued(StreamLane lane)
+    {
+      StreamStats &stats = _write_stats[size_t(lane)];
+      stats.high_water   = math::max(stats.high_water, uint16_t(_write_bufs[size_t(lane)].size()));
+
+      kick();
+    }
+
+  private:
+    void dropped(StreamLane lane, size_t len)
+    {
+      StreamStats &stats = _write_stats[size_t(lane)];
+      stats.dropped_messages++;
+      stats.dropped_bytes += len;
+    }
+
+    // Lane aware transmit functions, see StreamInterface.
+
+  public:
+    size_t write(StreamLane lane, const uint8_t *buf, size_t len)
+    {
+      const ConstSpan span = {buf, len};
+
+      return write(lane, &span, 1);
+    }
+
+  public:
+    size_t write(StreamLane lane, const ConstSpan *spans, size_t count)
+    {
+      WriteBuffer &write_buf = _write_bufs[size_t(lane)];
+
+      size_t len = 0;
+      for (size_t i = 0; i < count; ++i)
       {
-        _write_chunk[i] = _write_buf.get();
-      }*/
+        len += spans[i].len;
+      }
 
-      _write_buf.get_bulk(_write_chunk, next_chunk_size);
+      if (write_buf.available() < len)
+      {
+        // There's not enough space to enqueue this message.
+        dropped(lane, len);
+        return 0;
+      }
 
-      _is_writing = true;
+      for (size_t i = 0; i < count; ++i)
+      {
+        write_buf.put_bulk(spans[i].data, spans[i].len);
+      }
+      enqueued(lane);
 
-      write_raw(_write_chunk, next_chunk_size);
+      return len;
     }
 
-    // StreamInterface implementation.
+  public:
+    size_t reserve(StreamLane lane, MutableSpan spans[2], size_t len)
+    {
+      const size_t free = _write_bufs[size_t(lane)].reserve(&spans[0].data, &spans[0].len, &spans[1].data,
+                                                            &spans[1].len);
+
+      if (free < len)
+      {
+        dropped(lane, len);
+      }
+
+      return free;
+    }
 
   public:
-    size_t available() const override
+    void commit(StreamLane lane, size_t len)
     {
-      return _read_buf.size();
+      _write_bufs[size_t(lane)].commit(len);
+      enqueued(lane);
     }
 
   public:
-    uint8_t read() override
+    bool get_stats(StreamLane lane, StreamStats *stats) const override
     {
-      return _read_buf.get();
+      *stats          = _write_stats[size_t(lane)];
+      stats->capacity = uint16_t(WriteBufSize);
+
+      return true;
     }
 
   public:
-    size_t write(const uint8_t *buf, size_t len) override
+    // Stream writing to a single lane, reading from the shared receive buffer.
+    StreamInterface *lane(StreamLane lane)
+    {
+      return &_lanes[size_t(lane)];
+    }
+
+    // StreamInterface implementation, writes go to the telemetry lane.
+
+  public:
+    size_t available() const override
+    {
+      return math::min(size_t(_read_head - _read_tail), ReadBufSize) + (_read_resync ? 1 : 0);
+    }
+
+  public:
+    uint8_t read() override
     {
-      if (_write_buf.available() < len)
+      // The reception restarted, e.g. at a new baud rate: the zero ends the frame being decoded,
+      // whose remaining bytes were lost
+      if (_read_resync)
       {
-        // There's not enough space to enqueue this message.
+        _read_resync = false;
         return 0;
       }
 
-      // Old: Optimize CircularBuffer for bulk puts.
-      /*for (size_t i = 0; i < len; ++i)
-      {
-        _write_buf.put(buf[i]);
-      }*/
+      const size_t head = _read_head;
 
-      _write_buf.put_bulk(const_cast<uint8_t *>(buf), len);
+      if (head - _read_tail > ReadBufSize)
+      {
+        // The DMA lapped the reader, drop the pending bytes: the DMA may already be past the
+        // reported head and overwriting the oldest ones. The zero returned ends the frame being
+        // decoded, which lost bytes, so the decoder resynchronises on the next frame.
+        _read_overruns++;
+        _read_tail = head;
+        return 0;
+      }
 
-      if (!_is_writing)
+      if (_read_tail == head)
       {
-        // TODO: Optimize this case. No need for the first chunk to go through the circular buffer.
-        write_next_chunk();
+        return 0;
       }
 
-      return len;
+      return _read_buf[_read_tail++ % ReadBufSize];
+    }
+
+  public:
+    size_t write(const uint8_t *buf, size_t len) override
+    {
+      return write(StreamLane::Telemetry, buf, len);
+    }
+
+  public:
+    size_t write(const ConstSpan *spans, size_t count) override
+    {
+      return write(StreamLane::Telemetry, spans, count);
+    }
+
+  public:
+    size_t reserve(MutableSpan spans[2], size_t len) override
+    {
+      return reserve(StreamLane::Telemetry, spans, len);
+    }
+
+  public:
+    void commit(size_t len) override
+    {
+      commit(StreamLane::Telemetry, len);
     }
 };
@@ -62,51 +62,35 @@ void DS18B20Driver::start_all()
 	delay_us(750);
 }
 
-float DS18B20Driver::read_temperature_single()
+float DS18B20Driver::scratchpad_to_temperature(uint8_t *data)
 {
-	uint8_t data[9];
 	uint8_t temp_lsb, temp_msb;
-	uint8_t k;
 	uint16_t temp_c = -127;
 	uint8_t resolution;
 	int8_t digit, minus = 0;
 	float decimal = -127.f;
 
-	start_all();
-
-	_bus->reset();
-
-	_bus->write_byte(DS18B20_CMD_SKIPROM); // Skip ROM
-	_bus->write_byte(DS18B20_CMD_RSCRATCHPAD); // Read Scratch Pad
-
-	for(k = 0; k < 9; k++)
-	{
-		data[k] = _bus->read_byte();
-	}
-
 	temp_msb = data[1]; // Sign byte = 5 sign bits + 3 ms bits for temp (2^6, 2^5, 2^4)
 	temp_lsb = data[0]; // Temp data for 2^3 jusqu´à 2^-4 pour avoir une resolution à 12bits
 
 	temp_c = temp_lsb | (temp_msb << 8);
 
-	_bus->reset();
-
-	/* Check if temperature is negative */
+	// Check if temperature is negative
 	if(temp_c & 0x8000)
 	{
-		/* Two's complement, temperature is negative */
+		// Two's complement, temperature is negative
 		temp_c = ~temp_c + 1;
 		minus = 1;
 	}
 
-	/* Get sensor resolution */
+	// Get sensor resolution
 	resolution = ((data[4] & 0x60) >> 5) + 9;
 
-	/* Store temperature integer digits and decimal digits */
+	// Store temperature integer digits and decimal digits
 	digit = temp_c >> 4;
 	digit |= ((temp_c >> 8) & 0x7) << 4;
 
-	/* Store decimal digits */
+	// Store decimal digits
 	switch(resolution)
 	{
 		case 9:
@@ -140,7 +124,7 @@ float DS18B20Driver::read_temperature_single()
 		}
 	}
 
-	/* Check for negative part */
+	// Check for negative part
 	decimal = digit + decimal;
 	if(minus)
 	{
@@ -150,15 +134,32 @@ float DS18B20Driver::read_temperature_single()
 	return decimal;
 }
 
+float DS18B20Driver::read_temperature_single()
+{
+	uint8_t data[9];
+	uint8_t k;
+
+	start_all();
+
+	_bus->reset();
+
+	_bus->write_byte(DS18B20_CMD_SKIPROM); // Skip ROM
+	_bus->write_byte(DS18B20_CMD_RSCRATCHPAD); // Read Scratch Pad
+
+	for(k = 0; k < 9; k++)
+	{
+		data[k] = _bus->read_byte();
+	}
+
+	_bus->reset();
+
+	return scratchpad_to_temperature(data);
+}
+
 float DS18B20Driver::read_temperature_multiple(uint8_t *ROM)
 {
 	uint8_t data[9];
-	uint8_t temp_lsb, temp_msb;
 	uint8_t k;
-	uint16_t temp_c = -127;
-	uint8_t resolution;
-	int8_t digit, minus = 0;
-	float decimal = -127.f;
 	uint8_t crc;
 
 	_bus->reset();
@@ -181,70 +182,200 @@ float DS18B20Driver::read_temperature_multiple(uint8_t *ROM)
 		return -127.f;
 	}
 
-	temp_msb = data[1]; // Sign byte = 5 sign bits + 3 ms bits for temp (2^6, 2^5, 2^4)
-	temp_lsb = data[0]; // Temp data for 2^3 jusqu´à 2^-4 pour avoir une resolution à 12bits
+	_bus->reset();
 
-	temp_c = temp_lsb | (temp_msb << 8);
+	return scratchpad_to_temperature(data);
+}
 
-	_bus->reset();
+void DS18B20Driver::update()
+{
+	const uint8_t convert_cmd[2] = { DS18B20_CMD_SKIPROM, DS18B20_CMD_CONVERTTEMP };
 
-	// Check if temperature is negative
-	if(temp_c & 0x8000)
+	// Wait for the background transfer of the previous call
+	if(_bus->busy())
 	{
-		// Two's complement, temperature is negative
-		temp_c = ~temp_c + 1;
-		minus = 1;
+		return;
 	}
 
-	// Get sensor resolution
-	resolution = ((data[4] & 0x60) >> 5) + 9;
-
-	// Store temperature integer digits and decimal digits
-	digit = temp_c >> 4;
-	digit |= ((temp_c >> 8) & 0x7) << 4;
-
-	// Store decimal digits
-	switch(resolution)
+	switch(_state)
 	{
-		case 9:
+		case DS18B20_STATE_SCAN:
 		{
-			decimal = (temp_c >> 3) & 0x01;
-			decimal *= (float) 0.5;
+			// Search from the first device, the search runs in the background
+			_scan_count = 0;
+			_rescan = 0;
+			_bus->reset_search();
+			_bus->start_search();
+			_state = DS18B20_STATE_SEARCH;
 		}
 			break;
-		case 10:
+		case DS18B20_STATE_SEARCH:
 		{
-			decimal = (temp_c >> 2) & 0x03;
-			decimal *= (float) 0.25;
+			if(search_step())
+			{
+				_bus->start_search();
+			}
+			else
+			{
+				_device_count = _scan_count;
+				_state = DS18B20_STATE_IDLE;
+			}
 		}
 			break;
-		case 11:
+		case DS18B20_STATE_IDLE:
 		{
-			decimal = (temp_c >> 1) & 0x07;
-			decimal *= (float) 0.125;
+			// A sensor was plugged in
+			if(_bus->hot_plug_detected() || (_device_count == 0 && _bus->reset() == 0))
+			{
+				_state = DS18B20_STATE_SCAN;
+			}
+			// Start a conversion on all sensors and return, they convert on their own
+			else if(_device_count > 0 && _bus->reset() == 0)
+			{
+				_bus->start_write(convert_cmd, sizeof(convert_cmd));
+				_conv_start_ms = HAL_GetTick();
+				_state = DS18B20_STATE_CONVERTING;
+			}
 		}
 			break;
-		case 12:
+		case DS18B20_STATE_CONVERTING:
 		{
-			decimal = temp_c & 0x0F;
-			decimal *= (float) 0.0625;
+			if(HAL_GetTick() - _conv_start_ms > conversion_time_ms())
+			{
+				_sensor_idx = 0;
+				_max_resolution = 0;
+				_state = DS18B20_STATE_SELECT;
+			}
+		}
+			break;
+		case DS18B20_STATE_SELECT:
+		{
+			uint8_t select_cmd[10];
+
+			select_cmd[0] = DS18B20_CMD_MATCHROM;
+			memcpy(&select_cmd[1], _roms[_sensor_idx], 8);
+			select_cmd[9] = DS18B20_CMD_RSCRATCHPAD;
+
+			// No presence pulse, the sensor was unplugged
+			if(_bus->reset() != 0)
+			{
+				_rescan = 1;
+				next_sensor();
+				break;
+			}
+
+			_bus->start_write(select_cmd, sizeof(select_cmd));
+			_scratchpad_idx = 0;
+			_scratchpad_pending = 0;
+			_state = DS18B20_STATE_READING;
+		}
+			break;
+		case DS18B20_STATE_READING:
+		{
+			// Spread the scratchpad read over several ticks
+			_scratchpad_idx += _scratchpad_pending;
+			_scratchpad_pending = 0;
+
+			if(_scratchpad_idx < DS18B20_SCRATCHPAD_SIZE)
+			{
+				uint8_t n = DS18B20_SCRATCHPAD_SIZE - _scratchpad_idx;
+				if(n > DS18B20_READ_BYTES_PER_UPDATE)
+				{
+					n = DS18B20_READ_BYTES_PER_UPDATE;
+				}
+				if(_bus->start_read(&_scratchpad[_scratchpad_idx], n))
+				{
+					_scratchpad_pending = n;
+				}
+			}
+			else
+			{
+				read_complete();
+			}
 		}
 			break;
 		default:
 		{
-			decimal = 0xFF;
-			digit = 0;
+			_state = DS18B20_STATE_IDLE;
 		}
 	}
+}
 
-	// Check for negative part
-	decimal = digit + decimal;
-	if(minus)
+uint8_t DS18B20Driver::search_step()
+{
+	if(!_bus->get_search_result())
 	{
-		decimal = 0 - decimal;
+		return 0;
 	}
 
-	return decimal;
+	// Keep DS18B20 sensors with a valid ROM only
+	if(_bus->_rom_no[0] == DS18B20_FAMILY_CODE && _bus->crc8(_bus->_rom_no, 7) == _bus->_rom_no[7])
+	{
+		memcpy(_roms[_scan_count], _bus->_rom_no, 8);
+		_temperatures[_scan_count] = {-127.f, rom_to_id(_roms[_scan_count], sizeof(uint64_t))};
+		_scan_count++;
+	}
+
+	return _scan_count < ONE_WIRE_SENSORS_MAX;
+}
+
+void DS18B20Driver::read_complete()
+{
+	if(_bus->crc8(_scratchpad, DS18B20_SCRATCHPAD_CRC) == _scratchpad[DS18B20_SCRATCHPAD_CRC])
+	{
+		uint8_t resolution = ((_scratchpad[DS18B20_SCRATCHPAD_CONFIG] & 0x60) >> 5) + 9;
+		if(resolution > _max_resolution)
+		{
+			_max_resolution = resolution;
+		}
+
+		_temperatures[_sensor_idx].temp = scratchpad_to_temperature(_scratchpad);
+		_updated |= (1 << _sensor_idx);
+	}
+	else
+	{
+		_crc_errors++;
+		_rescan = 1;
+	}
+
+	next_sensor();
+}
+
+void DS18B20Driver::next_sensor()
+{
+	if(++_sensor_idx < _device_count)
+	{
+		_state = DS18B20_STATE_SELECT;
+	}
+	else
+	{
+		if(_max_resolution > 0)
+		{
+			_resolution = _max_resolution;
+		}
+
+		// A sensor may have been unplugged or replaced, rebuild the ROM table
+		_state = _rescan ? DS18B20_STATE_SCAN : DS18B20_STATE_IDLE;
+	}
+}
+
+uint16_t DS18B20Driver::get_updated()
+{
+	uint16_t updated = _updated;
+
+	_updated = 0;
+
+	return updated;
+}
+
+uint32_t DS18B20Driver::get_crc_errors()
+{
+	return _crc_errors;
+}
+
+uint32_t DS18B20Driver::conversion_time_ms()
+{
+	return DS18B20_CONV_TIME_12BIT_MS >> (12 - _resolution);
 }
 
 void DS18B20Driver::read_all_temperatures()
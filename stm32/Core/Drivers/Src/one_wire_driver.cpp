@@ -10,125 +10,61 @@
 
 #include <one_wire_driver.hh>
 
-void OneWireDriver::gpio_set_pin_as_input()
-{
-	uint8_t i;
-	/* Go through all pins */
-	for(i = 0x00; i < 0x10; i++)
-	{
-		/* Pin is set */
-		if(_gpio_pin & (1 << i))
-		{
-			/* Set 00 bits combination for input */
-			_gpiox->MODER &= ~(0x03 << (2 * i));
-		}
-	}
-}
-
-void OneWireDriver::gpio_set_pin_as_output()
-{
-	uint8_t i;
-	/* Go through all pins */
-	for(i = 0x00; i < 0x10; i++)
-	{
-		/* Pin is set */
-		if(_gpio_pin & (1 << i))
-		{
-			/* Set 01 bits combination for output */
-			_gpiox->MODER = (_gpiox->MODER & ~(0x03 << (2 * i))) | (0x11 << (2 * i));
-		}
-	}
-}
-
 uint8_t OneWireDriver::reset()
 {
-	uint8_t response;
-
-	gpio_set_pin_as_output();   // set the pin as output
-	HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET);  // pull the pin low
-
-	delay_us(480);   // delay_us according to datasheet
-
-	gpio_set_pin_as_input();    // set the pin as input
-	delay_us(80);    // delay_us according to datasheet
-
-	response = HAL_GPIO_ReadPin(_gpiox, _gpio_pin); // if the pin is low i.e the presence pulse is detected
-
-	delay_us(410); // 480 us delay_us totally.
-
-	return response; // 0 is presence pulse detected and 1 if not
+	return _transport->reset();
 }
 
 uint8_t OneWireDriver::read_bit()
 {
-	uint8_t bit = 0;
-
-	gpio_set_pin_as_output();
-
-	HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET); // pull DQ low to start timeslot
-	delay_us(3);
-
-	//release line
-	gpio_set_pin_as_input();
-	delay_us(10); // delay_us 15us from start of timeslot to read
-
-	bit = HAL_GPIO_ReadPin(_gpiox, _gpio_pin);
-
-	delay_us(53);
-
-	return bit; // return value of DQ line
+	return _transport->read_bit();
 }
 
 void OneWireDriver::write_bit(uint8_t bit)
 {
-	if(bit)
-	{
-		gpio_set_pin_as_output();
-
-		HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET); // pull DQ low to start timeslot
-		delay_us(10);
-
-		HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_SET); // maintain DQ high for duration of time slot
-
-		delay_us(60); // hold value for remainder of timeslot
-
-		gpio_set_pin_as_input();
-	}
-	else
-	{
-		gpio_set_pin_as_output();
-
-		HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET); // pull DQ low to start timeslot
-		delay_us(65); // maintain DQ low for duration of time slot
-
-		gpio_set_pin_as_input(); // hold value for remainder of timeslot
-
-		delay_us(5);
-	}
+	_transport->write_bit(bit);
 }
 
 uint8_t OneWireDriver::read_byte()
 {
-	uint8_t i = 8, byte = 0;
+	return _transport->read_byte();
+}
 
-	while(i--)
-	{
-		byte >>= 1;
-		byte |= (read_bit() << 7);
-	}
+void OneWireDriver::write_byte(uint8_t byte)
+{
+	_transport->write_byte(byte);
+}
 
-	return byte;
+uint8_t OneWireDriver::start_write(const uint8_t *data, size_t len)
+{
+	return _transport->start_write(data, len);
 }
 
-void OneWireDriver::write_byte(uint8_t byte)
+uint8_t OneWireDriver::start_read(uint8_t *data, size_t len)
 {
-	uint8_t i = 8;
+	return _transport->start_read(data, len);
+}
 
-	while(i--)
-	{ // writes byte, one bit at a time
-		write_bit(byte & 0x01); // write bit from byte starting with lsb
-		byte >>= 1; // shifts byte right 'i' spaces
+uint8_t OneWireDriver::busy()
+{
+	if(_search_state != ONE_WIRE_SEARCH_IDLE && !_transport->busy())
+	{
+		if(_transport->runs_in_background())
+		{
+			/* The transfer timed out without completion interrupt */
+			search_end(0);
+		}
+		else
+		{
+			/* Synchronous transport, search a few bits per call */
+			for(uint8_t i = 0; i < ONE_WIRE_SEARCH_BITS_PER_POLL && _search_state != ONE_WIRE_SEARCH_IDLE; i++)
+			{
+				search_step();
+			}
+		}
 	}
+
+	return _search_state != ONE_WIRE_SEARCH_IDLE || _transport->busy();
 }
 
 uint8_t OneWireDriver::crc8(uint8_t *addr, uint8_t len)
@@ -162,136 +98,188 @@ void OneWireDriver::reset_search()
 	_last_family_discrepancy = 0;
 }
 
-uint8_t OneWireDriver::search()
+void OneWireDriver::start_search()
 {
-	uint8_t id_bit_number;
-	uint8_t last_zero, rom_byte_number, search_result;
-	uint8_t id_bit, cmp_id_bit;
-	uint8_t rom_byte_mask, search_direction;
+	const uint8_t search_cmd = DS18B20_CMD_SEARCHROM;
 
-	/* Initialize for search */
-	id_bit_number = 1;
-	last_zero = 0;
-	rom_byte_number = 0;
-	rom_byte_mask = 1;
-	search_result = 0;
+	_search_result = 0;
 
 	/* Check if any devices */
-	if(!_last_device_flag)
+	if(_last_device_flag)
+	{
+		search_end(0);
+		return;
+	}
+
+	/* 1-Wire reset */
+	if(reset())
+	{
+		search_end(0);
+		return;
+	}
+
+	/* Initialize for search */
+	_id_bit_number = 1;
+	_last_zero = 0;
+
+	/* Issue the search command, the bits are read once it is written */
+	_search_state = ONE_WIRE_SEARCH_COMMAND;
+	if(!_transport->start_write(&search_cmd, 1))
 	{
-		/* 1-Wire reset */
-		if(reset())
+		search_end(0);
+	}
+}
+
+uint8_t OneWireDriver::get_search_result()
+{
+	return _search_result;
+}
+
+uint8_t OneWireDriver::hot_plug_detected()
+{
+	return _search_state == ONE_WIRE_SEARCH_IDLE && _transport->hot_plug_detected();
+}
+
+void OneWireDriver::search_step()
+{
+	const uint8_t bits = _transport->get_bits();
+	uint8_t id_bit, cmp_id_bit;
+	uint8_t rom_byte_number, rom_byte_mask, search_direction;
+
+	switch(_search_state)
+	{
+		case ONE_WIRE_SEARCH_COMMAND:
+		{
+			/* Read the first bit and its complement */
+			_search_state = ONE_WIRE_SEARCH_BITS;
+			start_search_bits(0x03, 2);
+		}
+			return;
+		case ONE_WIRE_SEARCH_BITS:
+			break;
+		case ONE_WIRE_SEARCH_LAST_WRITE:
 		{
-			/* reset the search */
-			_last_discrepancy = 0;
-			_last_device_flag = 0;
-			_last_family_discrepancy = 0;
-			return 0;
+			search_end(1);
 		}
+			return;
+		default:
+			return;
+	}
 
-		/* Issue the search command */
-		write_byte (DS18B20_CMD_SEARCHROM);
+	/* The bit and its complement follow the direction written for the previous bit */
+	id_bit = (_id_bit_number == 1) ? (bits & 0x01) : ((bits >> 1) & 0x01);
+	cmp_id_bit = (_id_bit_number == 1) ? ((bits >> 1) & 0x01) : ((bits >> 2) & 0x01);
 
-		/* Loop to do the search */
-		do
-		{
-			/* Read a bit and its complement */
-			id_bit = read_bit();
-			cmp_id_bit = read_bit();
+	/* Check for no devices on 1-wire */
+	if((id_bit == 1) && (cmp_id_bit == 1))
+	{
+		search_end(0);
+		return;
+	}
 
-			/* Check for no devices on 1-wire */
-			if((id_bit == 1) && (cmp_id_bit == 1))
-			{
-				break;
-			}
-			else
-			{
-				/* All devices coupled have 0 or 1 */
-				if(id_bit != cmp_id_bit)
-				{
-					/* Bit write value for search */
-					search_direction = id_bit;
-				}
-				else
-				{
-					/* If this discrepancy is before the Last Discrepancy on a previous next then pick the same as last time */
-					if(id_bit_number < _last_discrepancy)
-					{
-						search_direction = ((_rom_no[rom_byte_number] & rom_byte_mask) > 0);
-					}
-					else
-					{
-						/* If equal to last pick 1, if not then pick 0 */
-						search_direction = (id_bit_number == _last_discrepancy);
-					}
-
-					/* If 0 was picked then record its position in LastZero */
-					if(search_direction == 0)
-					{
-						last_zero = id_bit_number;
-
-						/* Check for Last discrepancy in family */
-						if(last_zero < 9)
-						{
-							_last_family_discrepancy = last_zero;
-						}
-					}
-				}
-
-				/* Set or clear the bit in the ROM byte rom_byte_number with mask rom_byte_mask */
-				if(search_direction == 1)
-				{
-					_rom_no[rom_byte_number] |= rom_byte_mask;
-				}
-				else
-				{
-					_rom_no[rom_byte_number] &= ~rom_byte_mask;
-				}
-
-				/* Serial number search direction write bit */
-				write_bit(search_direction);
-
-				/* Increment the byte counter id_bit_number and shift the mask rom_byte_mask */
-				id_bit_number++;
-				rom_byte_mask <<= 1;
-
-				/* If the mask is 0 then go to new SerialNum byte rom_byte_number and reset mask */
-				if(rom_byte_mask == 0)
-				{
-					rom_byte_number++;
-					rom_byte_mask = 1;
-				}
-			}
-			/* Loop until through all ROM bytes 0-7 */
+	rom_byte_number = (_id_bit_number - 1) / 8;
+	rom_byte_mask = 1 << ((_id_bit_number - 1) % 8);
+
+	/* All devices coupled have 0 or 1 */
+	if(id_bit != cmp_id_bit)
+	{
+		/* Bit write value for search */
+		search_direction = id_bit;
+	}
+	else
+	{
+		/* If this discrepancy is before the Last Discrepancy on a previous next then pick the same as last time */
+		if(_id_bit_number < _last_discrepancy)
+		{
+			search_direction = ((_rom_no[rom_byte_number] & rom_byte_mask) > 0);
+		}
+		else
+		{
+			/* If equal to last pick 1, if not then pick 0 */
+			search_direction = (_id_bit_number == _last_discrepancy);
 		}
-		while(rom_byte_number < 8);
 
-		/* If the search was successful then */
-		if(!(id_bit_number < 65))
+		/* If 0 was picked then record its position in LastZero */
+		if(search_direction == 0)
 		{
-			/* search successful so set _last_discrepancy, _last_device_flag, search_result */
-			_last_discrepancy = last_zero;
+			_last_zero = _id_bit_number;
 
-			/* Check for last device */
-			if(_last_discrepancy == 0)
+			/* Check for Last discrepancy in family */
+			if(_last_zero < 9)
 			{
-				_last_device_flag = 1;
+				_last_family_discrepancy = _last_zero;
 			}
+		}
+	}
+
+	/* Set or clear the bit in the ROM byte rom_byte_number with mask rom_byte_mask */
+	if(search_direction == 1)
+	{
+		_rom_no[rom_byte_number] |= rom_byte_mask;
+	}
+	else
+	{
+		_rom_no[rom_byte_number] &= ~rom_byte_mask;
+	}
+
+	if(_id_bit_number == 64)
+	{
+		/* Serial number search direction write bit, the search is complete once written */
+		_search_state = ONE_WIRE_SEARCH_LAST_WRITE;
+		start_search_bits(search_direction, 1);
+	}
+	else
+	{
+		/* Serial number search direction write bit, then the next bit and its complement */
+		_id_bit_number++;
+		start_search_bits(search_direction | 0x06, 3);
+	}
+}
+
+void OneWireDriver::start_search_bits(uint8_t bits, uint8_t n_slots)
+{
+	if(!_transport->start_bits(bits, n_slots))
+	{
+		search_end(0);
+	}
+}
 
-			search_result = 1;
+void OneWireDriver::search_end(uint8_t found)
+{
+	if(found)
+	{
+		/* search successful so set _last_discrepancy, _last_device_flag */
+		_last_discrepancy = _last_zero;
+
+		/* Check for last device */
+		if(_last_discrepancy == 0)
+		{
+			_last_device_flag = 1;
 		}
 	}
 
 	/* If no device found then reset counters so next 'search' will be like a first */
-	if(!search_result || !_rom_no[0])
+	if(!found || !_rom_no[0])
 	{
 		_last_discrepancy = 0;
 		_last_device_flag = 0;
 		_last_family_discrepancy = 0;
-		search_result = 0;
+		found = 0;
+	}
+
+	_search_result = found;
+	_search_state = ONE_WIRE_SEARCH_IDLE;
+}
+
+uint8_t OneWireDriver::search()
+{
+	start_search();
+
+	while(busy())
+	{
 	}
 
-	return search_result;
+	return _search_result;
 }
 
 uint8_t OneWireDriver::first()
@@ -0,0 +1,104 @@
+/**
+ * @file    one_wire_transport.cpp
+ * @brief   Bit banged GPIO transport of the 1-wire bus.
+ *
+ */
+
+#include "one_wire_transport.hh"
+
+void OneWireGpioTransport::gpio_set_pin_as_input()
+{
+	uint8_t i;
+	/* Go through all pins */
+	for(i = 0x00; i < 0x10; i++)
+	{
+		/* Pin is set */
+		if(_gpio_pin & (1 << i))
+		{
+			/* Set 00 bits combination for input */
+			_gpiox->MODER &= ~(0x03 << (2 * i));
+		}
+	}
+}
+
+void OneWireGpioTransport::gpio_set_pin_as_output()
+{
+	uint8_t i;
+	/* Go through all pins */
+	for(i = 0x00; i < 0x10; i++)
+	{
+		/* Pin is set */
+		if(_gpio_pin & (1 << i))
+		{
+			/* Set 01 bits combination for output */
+			_gpiox->MODER = (_gpiox->MODER & ~(0x03 << (2 * i))) | (0x11 << (2 * i));
+		}
+	}
+}
+
+uint8_t OneWireGpioTransport::reset()
+{
+	uint8_t response;
+
+	gpio_set_pin_as_output();   // set the pin as output
+	HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET);  // pull the pin low
+
+	delay_us(480);   // delay_us according to datasheet
+
+	gpio_set_pin_as_input();    // set the pin as input
+	delay_us(80);    // delay_us according to datasheet
+
+	response = HAL_GPIO_ReadPin(_gpiox, _gpio_pin); // if the pin is low i.e the presence pulse is detected
+
+	delay_us(410); // 480 us delay_us totally.
+
+	return response; // 0 is presence pulse detected and 1 if not
+}
+
+uint8_t OneWireGpioTransport::read_bit()
+{
+	uint8_t bit = 0;
+
+	gpio_set_pin_as_output();
+
+	HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET); // pull DQ low to start timeslot
+	delay_us(3);
+
+	//release line
+	gpio_set_pin_as_input();
+	delay_us(10); // delay_us 15us from start of timeslot to read
+
+	bit = HAL_GPIO_ReadPin(_gpiox, _gpio_pin);
+
+	delay_us(53);
+
+	return bit; // return value of DQ line
+}
+
+void OneWireGpioTransport::write_bit(uint8_t bit)
+{
+	if(bit)
+	{
+		gpio_set_pin_as_output();
+
+		HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET); // pull DQ low to start timeslot
+		delay_us(10);
+
+		HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_SET); // maintain DQ high for duration of time slot
+
+		delay_us(60); // hold value for remainder of timeslot
+
+		gpio_set_pin_as_input();
+	}
+	else
+	{
+		gpio_set_pin_as_output();
+
+		HAL_GPIO_WritePin(_gpiox, _gpio_pin, GPIO_PIN_RESET); // pull DQ low to start timeslot
+		delay_us(65); // maintain DQ low for duration of time slot
+
+		gpio_set_pin_as_input(); // hold value for remainder of timeslot
+
+		delay_us(5);
+	}
+}
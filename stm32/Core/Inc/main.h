@@ -83,6 +83,38 @@ void delay_us(uint32_t us);
 #define TIM_CLK_FREQ_HZ 80000000
 #define MAX_UINT16_T 0x0000FFFF
 #define MAX_UINT32_T 0xFFFFFFFF
+
+/* ADC1/ADC2 dual regular simultaneous mode: pairs position and current samples */
+#define SEN_FB_ADC_DUAL_MODE 1
+
+/* HX711 RATE input (low 10 SPS, high 80 SPS) is hardwired on this board. If it is routed to the MCU,
+ * define HX711_RATE_Pin and HX711_RATE_GPIO_Port: the driver sets it as output and selects 80 SPS */
+
+/* 1-wire bus driven by USART1 in half-duplex mode (TX swapped onto the DS18B20 pin) instead of GPIO bit banging */
+#define ONE_WIRE_UART_TRANSPORT 1
+
+/* 1-wire bus driven by TIM1 CH3 (PWM) and CH4 (capture) with DMA, exclusive with ONE_WIRE_UART_TRANSPORT.
+ * PA10 is TIM1_CH3, delay_us() then runs on TIM6 instead of TIM1 */
+#define ONE_WIRE_TIMER_TRANSPORT 0
+
+#if ONE_WIRE_UART_TRANSPORT && ONE_WIRE_TIMER_TRANSPORT
+#error "Select a single 1-wire transport"
+#endif
+
+/* Host commands on USART2 (ST-Link virtual COM port) and telemetry on USART3, 0 shares USART3 */
+#define SERIAL_SPLIT_PORTS 1
+
+/* Telemetry link (USART3) baud rate after reset, a higher rate is negotiated by the host */
+#define SERIAL_BOOT_BAUDRATE 115200U
+
+/* RTS/CTS flow control on the telemetry link, CTS on PB13 and RTS on PB14 */
+#define SERIAL_HW_FLOW_CONTROL 0
+
+/* Runtime parameters saved to the last flash page (reserved in STM32L476RGTX_FLASH.ld) */
+#define PARAM_FLASH_PERSISTENCE 1
+
+/* CRC16 of the framing computed by the CRC peripheral instead of a table */
+#define CRC_HW_BACKEND 1
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
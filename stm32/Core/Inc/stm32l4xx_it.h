@@ -62,7 +62,18 @@ void ADC1_2_IRQHandler(void);
 void USART2_IRQHandler(void);
 void USART3_IRQHandler(void);
 /* USER CODE BEGIN EFP */
-
+void DMA1_Channel2_IRQHandler(void);
+void TIM7_IRQHandler(void);
+void EXTI9_5_IRQHandler(void);
+#if ONE_WIRE_UART_TRANSPORT
+void DMA1_Channel4_IRQHandler(void);
+void DMA1_Channel5_IRQHandler(void);
+void USART1_IRQHandler(void);
+#endif
+#if ONE_WIRE_TIMER_TRANSPORT
+void DMA1_Channel4_IRQHandler(void);
+#endif
+void DMA1_Channel7_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
@@ -26,12 +26,15 @@
 
 #include "sensor_feedback_driver.hh"
 #include "one_wire_driver.hh"
+#include "one_wire_uart_transport.hh"
+#include "one_wire_timer_transport.hh"
 #include "ds18b20_driver.hh"
 #include "high_level_controller.hh"
 #include "hx711_driver.hh"
 #include "servo_p500_driver.hh"
 #include "uart_driver.hh"
 #include "serial_interface.hh"
+#include "baudrate_negotiator.hh"
 #include "timer_driver.hh"
 /* USER CODE END Includes */
 
@@ -42,6 +45,12 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#if ONE_WIRE_TIMER_TRANSPORT
+// TIM1 drives the 1-wire bus
+#define DELAY_US_HTIM htim6
+#else
+#define DELAY_US_HTIM htim1
+#endif
 
 /* USER CODE END PD */
 
@@ -65,21 +74,56 @@ DMA_HandleTypeDef hdma_usart2_rx;
 DMA_HandleTypeDef hdma_usart3_rx;
 
 /* USER CODE BEGIN PV */
+DMA_HandleTypeDef hdma_usart3_tx;
+#if !ONE_WIRE_TIMER_TRANSPORT
+DMA_HandleTypeDef hdma_usart2_tx;
+#endif
+#if SEN_FB_ADC_DUAL_MODE
+ADC_HandleTypeDef hadc2;
+#endif
+TIM_HandleTypeDef htim7;
+#if ONE_WIRE_UART_TRANSPORT
+UART_HandleTypeDef huart1;
+DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart1_tx;
+#endif
+#if ONE_WIRE_TIMER_TRANSPORT
+TIM_HandleTypeDef htim6;
+DMA_HandleTypeDef hdma_tim1_ch3;
+DMA_HandleTypeDef hdma_tim1_ch4;
+#endif
+
+TimerDriver timer;
 
 // Servo driver
 ServoP500Driver servo(&htim2, TIM_CHANNEL_2);
 
 // Sensor feedback
-OneWireDriver ds18b20_1wire(DS18B20_GPIO_Port, DS18B20_Pin);
+#if ONE_WIRE_UART_TRANSPORT
+OneWireUartTransport ds18b20_transport(&huart1);
+#elif ONE_WIRE_TIMER_TRANSPORT
+OneWireTimerTransport ds18b20_transport(&htim1, TIM_CHANNEL_3, TIM_CHANNEL_4, &hdma_tim1_ch3, &hdma_tim1_ch4);
+#else
+OneWireGpioTransport ds18b20_transport(DS18B20_GPIO_Port, DS18B20_Pin);
+#endif
+OneWireDriver ds18b20_1wire(&ds18b20_transport);
 DS18B20Driver temp_sensors(&ds18b20_1wire);
-HX711Driver load_cell(HX711_CLK_GPIO_Port, HX711_CLK_Pin, HX711_DATA_GPIO_Port, HX711_DATA_Pin);
-SensorFeedbackDriver sensors(&hadc1, &load_cell, &temp_sensors);
+HX711Driver load_cell(HX711_CLK_GPIO_Port, HX711_CLK_Pin, HX711_DATA_GPIO_Port, HX711_DATA_Pin,
+                      EXTI9_5_IRQn, &htim7, &timer);
+CurrentProfileSampler current_profile(&hadc1, ADC_CHANNEL_3, &htim2, TIM_CHANNEL_1);
 
-// host-PC interface
-UartDriver serial(&huart3);
-SerialInterface host_pc(&serial);
+// Runtime parameters, restored from flash before use
+ParamServer params;
+SensorFeedbackDriver sensors(&hadc1, &load_cell, &temp_sensors, &current_profile, params.values());
 
-TimerDriver timer;
+// host-PC interface
+UartDriver serial_telem(&huart3);
+#if SERIAL_SPLIT_PORTS
+UartDriver serial_cmd(&huart2);
+#else
+UartDriver &serial_cmd = serial_telem;
+#endif
+BaudrateNegotiator telem_link(&serial_telem, SERIAL_BOOT_BAUDRATE);
 
 /* USER CODE END PV */
 
@@ -94,6 +138,17 @@ static void MX_DAC1_Init(void);
 static void MX_TIM1_Init(void);
 static void MX_USART3_UART_Init(void);
 /* USER CODE BEGIN PFP */
+#if SEN_FB_ADC_DUAL_MODE
+static void ADC2_DualMode_Init(void);
+#endif
+static void TIM7_HX711_Init(void);
+#if ONE_WIRE_UART_TRANSPORT
+static void USART1_OneWire_Init(void);
+#endif
+#if ONE_WIRE_TIMER_TRANSPORT
+static void TIM6_Delay_Init(void);
+static void TIM1_OneWire_Init(void);
+#endif
 
 /* USER CODE END PFP */
 
@@ -140,9 +195,29 @@ int main(void)
   /* USER CODE BEGIN 2 */
 
   // delay_us() timer
-  HAL_TIM_Base_Start(&htim1);
-  serial.start();
-  ServoController servo_ctrl(&timer, &servo, &sensors, &host_pc, &serial);
+#if ONE_WIRE_TIMER_TRANSPORT
+  TIM6_Delay_Init();
+#endif
+  HAL_TIM_Base_Start(&DELAY_US_HTIM);
+  // HX711 serial clock timer
+  TIM7_HX711_Init();
+#if ONE_WIRE_UART_TRANSPORT
+  // DS18B20 1-wire bus
+  USART1_OneWire_Init();
+#elif ONE_WIRE_TIMER_TRANSPORT
+  // DS18B20 1-wire bus
+  TIM1_OneWire_Init();
+#endif
+  crc_backend_init();
+#if PARAM_FLASH_PERSISTENCE
+  params.load();
+#endif
+  serial_telem.start();
+#if SERIAL_SPLIT_PORTS
+  serial_cmd.start();
+#endif
+  ServoController servo_ctrl(&timer, &servo, &sensors, serial_cmd.lane(StreamLane::Control), &telem_link, &serial_telem,
+                             &params);
   servo_ctrl.init();
   /* USER CODE END 2 */
 
@@ -296,7 +371,9 @@ static void MX_ADC1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN ADC1_Init 2 */
-
+#if SEN_FB_ADC_DUAL_MODE
+  ADC2_DualMode_Init();
+#endif
   /* USER CODE END ADC1_Init 2 */
 
 }
@@ -505,7 +582,13 @@ static void MX_USART3_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART3_Init 2 */
-
+#if SERIAL_HW_FLOW_CONTROL
+  huart3.Init.HwFlowCtl = UART_HWCONTROL_RTS_CTS;
+  if (HAL_UART_Init(&huart3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
   /* USER CODE END USART3_Init 2 */
 
 }
@@ -602,20 +685,377 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
+#if SEN_FB_ADC_DUAL_MODE
+/**
+  * @brief ADC2 Initialization Function, slave of ADC1 in dual regular simultaneous mode.
+  *        ADC2 converts the current channel while ADC1 converts a position channel
+  *        (see SenFbAdc2ChType_t), both results are read at once by the ADC1 DMA.
+  * @param None
+  * @retval None
+  */
+static void ADC2_DualMode_Init(void)
+{
+  ADC_MultiModeTypeDef multimode = {0};
+  ADC_ChannelConfTypeDef sConfig = {0};
+
+  hadc2.Instance = ADC2;
+  hadc2.Init = hadc1.Init;
+  hadc2.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+  hadc2.Init.DMAContinuousRequests = DISABLE;
+  if (HAL_ADC_Init(&hadc2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sConfig.SamplingTime = ADC_SAMPLETIME_92CYCLES_5;
+  sConfig.SingleDiff = ADC_SINGLE_ENDED;
+  sConfig.OffsetNumber = ADC_OFFSET_NONE;
+  sConfig.Offset = 0;
+
+  sConfig.Channel = ADC_CHANNEL_3;
+  sConfig.Rank = ADC_REGULAR_RANK_1;
+  if (HAL_ADC_ConfigChannel(&hadc2, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfig.Rank = ADC_REGULAR_RANK_2;
+  if (HAL_ADC_ConfigChannel(&hadc2, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfig.Channel = ADC_CHANNEL_1;
+  sConfig.Rank = ADC_REGULAR_RANK_3;
+  if (HAL_ADC_ConfigChannel(&hadc2, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfig.Channel = ADC_CHANNEL_3;
+  sConfig.Rank = ADC_REGULAR_RANK_4;
+  if (HAL_ADC_ConfigChannel(&hadc2, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  multimode.Mode = ADC_DUALMODE_REGSIMULT;
+  multimode.DMAAccessMode = ADC_DMAACCESSMODE_12_10_BITS;
+  multimode.TwoSamplingDelay = ADC_TWOSAMPLINGDELAY_1CYCLE;
+  if (HAL_ADCEx_MultiModeConfigChannel(&hadc1, &multimode) != HAL_OK)
+  {
+    Error_Handler();
+  }
+}
+#endif
+
+/**
+  * @brief TIM7 Initialization Function, generates the HX711 serial clock edges.
+  * @param None
+  * @retval None
+  */
+static void TIM7_HX711_Init(void)
+{
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  __HAL_RCC_TIM7_CLK_ENABLE();
+
+  htim7.Instance = TIM7;
+  htim7.Init.Prescaler = 80-1;
+  htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim7.Init.Period = HX711_CLK_HALF_PERIOD_US-1;
+  htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim7) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim7, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  HAL_NVIC_SetPriority(TIM7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(TIM7_IRQn);
+  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 0, 0);
+}
+
+#if ONE_WIRE_UART_TRANSPORT
+/**
+  * @brief USART1 Initialization Function, single-wire half-duplex 1-wire bus.
+  *        TX and RX are swapped so that TX drives the DS18B20 pin (PA10), the
+  *        slots are sent and received by DMA1 channel 4 and 5.
+  * @param None
+  * @retval None
+  */
+static void USART1_OneWire_Init(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+  RCC_PeriphCLKInitTypeDef PeriphClkInit = {0};
+
+  PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_USART1;
+  PeriphClkInit.Usart1ClockSelection = RCC_USART1CLKSOURCE_PCLK2;
+  if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_RCC_USART1_CLK_ENABLE();
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+
+  /* USART1 GPIO Configuration
+  PA10     ------> USART1_TX (swapped), open drain with the bus pull-up
+  */
+  GPIO_InitStruct.Pin = DS18B20_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+  GPIO_InitStruct.Alternate = GPIO_AF7_USART1;
+  HAL_GPIO_Init(DS18B20_GPIO_Port, &GPIO_InitStruct);
+
+  /* USART1_RX Init */
+  hdma_usart1_rx.Instance = DMA1_Channel5;
+  hdma_usart1_rx.Init.Request = DMA_REQUEST_2;
+  hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma_usart1_rx.Init.Mode = DMA_NORMAL;
+  hdma_usart1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+  if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&huart1, hdmarx, hdma_usart1_rx);
+
+  /* USART1_TX Init */
+  hdma_usart1_tx.Instance = DMA1_Channel4;
+  hdma_usart1_tx.Init.Request = DMA_REQUEST_2;
+  hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+  hdma_usart1_tx.Init.Priority = DMA_PRIORITY_HIGH;
+  if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
+
+  HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+  HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+  HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(USART1_IRQn);
+
+  huart1.Instance = USART1;
+  huart1.Init.BaudRate = ONE_WIRE_UART_DATA_BAUDRATE;
+  huart1.Init.WordLength = UART_WORDLENGTH_8B;
+  huart1.Init.StopBits = UART_STOPBITS_1;
+  huart1.Init.Parity = UART_PARITY_NONE;
+  huart1.Init.Mode = UART_MODE_TX_RX;
+  huart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+  huart1.Init.OverSampling = UART_OVERSAMPLING_16;
+  huart1.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+  huart1.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_SWAP_INIT;
+  huart1.AdvancedInit.Swap = UART_ADVFEATURE_SWAP_ENABLE;
+  if (HAL_HalfDuplex_Init(&huart1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+}
+#endif
+
+#if ONE_WIRE_TIMER_TRANSPORT
+/**
+  * @brief TIM6 Initialization Function, 1 MHz time base of delay_us().
+  * @param None
+  * @retval None
+  */
+static void TIM6_Delay_Init(void)
+{
+  __HAL_RCC_TIM6_CLK_ENABLE();
+
+  htim6.Instance = TIM6;
+  htim6.Init.Prescaler = 80-1;
+  htim6.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim6.Init.Period = 65535;
+  htim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim6) != HAL_OK)
+  {
+    Error_Handler();
+  }
+}
+
+/**
+  * @brief TIM1 Initialization Function, 1-wire slot generator.
+  *        CH3 drives the DS18B20 pin (PA10) in PWM mode, active low, CH4 captures
+  *        the rising edges of the same pin. The slot pulse widths are loaded by
+  *        DMA1 channel 7 and the captures stored by DMA1 channel 4.
+  * @param None
+  * @retval None
+  */
+static void TIM1_OneWire_Init(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+  TIM_OC_InitTypeDef sConfigOC = {0};
+  TIM_IC_InitTypeDef sConfigIC = {0};
+
+  /* TIM1 GPIO Configuration
+  PA10     ------> TIM1_CH3, open drain with the bus pull-up
+  */
+  GPIO_InitStruct.Pin = DS18B20_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+  GPIO_InitStruct.Alternate = GPIO_AF1_TIM1;
+  HAL_GPIO_Init(DS18B20_GPIO_Port, &GPIO_InitStruct);
+
+  /* TIM1_CH3 Init */
+  hdma_tim1_ch3.Instance = DMA1_Channel7;
+  hdma_tim1_ch3.Init.Request = DMA_REQUEST_7;
+  hdma_tim1_ch3.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma_tim1_ch3.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_tim1_ch3.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_tim1_ch3.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  hdma_tim1_ch3.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  hdma_tim1_ch3.Init.Mode = DMA_NORMAL;
+  hdma_tim1_ch3.Init.Priority = DMA_PRIORITY_VERY_HIGH;
+  if (HAL_DMA_Init(&hdma_tim1_ch3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* TIM1_CH4 Init */
+  hdma_tim1_ch4.Instance = DMA1_Channel4;
+  hdma_tim1_ch4.Init.Request = DMA_REQUEST_7;
+  hdma_tim1_ch4.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma_tim1_ch4.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_tim1_ch4.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_tim1_ch4.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  hdma_tim1_ch4.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  hdma_tim1_ch4.Init.Mode = DMA_NORMAL;
+  hdma_tim1_ch4.Init.Priority = DMA_PRIORITY_VERY_HIGH;
+  if (HAL_DMA_Init(&hdma_tim1_ch4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+  HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+
+  // 1 MHz counter, one slot per period
+  htim1.Init.Prescaler = 80-1;
+  htim1.Init.Period = ONE_WIRE_TIMER_SLOT_US-1;
+  htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_PWM_Init(&htim1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sConfigOC.OCMode = TIM_OCMODE_PWM1;
+  sConfigOC.Pulse = 0;
+  sConfigOC.OCPolarity = TIM_OCPOLARITY_LOW;
+  sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+  sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+  sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
+  sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+  if (HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC, TIM_CHANNEL_3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+  sConfigIC.ICSelection = TIM_ICSELECTION_INDIRECTTI;
+  sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
+  sConfigIC.ICFilter = 0;
+  if (HAL_TIM_IC_ConfigChannel(&htim1, &sConfigIC, TIM_CHANNEL_4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  // Enables the channels and the main output, the transport starts the counter per transfer
+  HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_3);
+  HAL_TIM_IC_Start(&htim1, TIM_CHANNEL_4);
+  htim1.Instance->CR1 &= ~TIM_CR1_CEN;
+}
+#endif
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if(htim->Instance == load_cell.get_tim_instance())
+  {
+    load_cell.on_clock_tick();
+  }
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  if(GPIO_Pin == load_cell.get_dat_pin())
+  {
+    load_cell.on_data_ready();
+  }
+}
+
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
-	if(huart->Instance == serial.get_instance())
+	if(huart->Instance == serial_telem.get_instance())
 	{
-		serial.on_tx_completed();
+		serial_telem.on_tx_completed();
 	}
+#if SERIAL_SPLIT_PORTS
+	else if(huart->Instance == serial_cmd.get_instance())
+	{
+		serial_cmd.on_tx_completed();
+	}
+#endif
+#if ONE_WIRE_UART_TRANSPORT
+	else if(huart->Instance == ds18b20_transport.get_instance())
+	{
+		ds18b20_transport.on_tx_completed();
+	}
+#endif
 }
 
+#if ONE_WIRE_UART_TRANSPORT
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-	if(huart->Instance == serial.get_instance())
+	if(huart->Instance == ds18b20_transport.get_instance())
+	{
+		ds18b20_transport.on_rx_completed();
+	}
+}
+#endif
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	if(huart->Instance == serial_telem.get_instance())
+	{
+		serial_telem.on_rx_event(Size);
+	}
+#if SERIAL_SPLIT_PORTS
+	else if(huart->Instance == serial_cmd.get_instance())
 	{
-		serial.on_rx_completed();
+		serial_cmd.on_rx_event(Size);
 	}
+#endif
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if(huart->Instance == serial_telem.get_instance())
+	{
+		serial_telem.on_error();
+	}
+#if SERIAL_SPLIT_PORTS
+	else if(huart->Instance == serial_cmd.get_instance())
+	{
+		serial_cmd.on_error();
+	}
+#endif
 }
 
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
@@ -626,10 +1066,18 @@ void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
   }
 }
 
+void HAL_ADCEx_InjectedConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+  if(hadc->Instance == sensors.get_adc_instance())
+  {
+    sensors.on_adc_injected_cplt_conv();
+  }
+}
+
 void delay_us(uint32_t us)
 {
-	__HAL_TIM_SET_COUNTER(&htim1, 0);
-	while(__HAL_TIM_GET_COUNTER(&htim1) < us);
+	__HAL_TIM_SET_COUNTER(&DELAY_US_HTIM, 0);
+	while(__HAL_TIM_GET_COUNTER(&DELAY_US_HTIM) < us);
 }
 /* USER CODE END 4 */
 
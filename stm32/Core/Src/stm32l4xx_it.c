@@ -62,7 +62,20 @@ extern DMA_HandleTypeDef hdma_usart3_rx;
 extern UART_HandleTypeDef huart2;
 extern UART_HandleTypeDef huart3;
 /* USER CODE BEGIN EV */
-
+extern TIM_HandleTypeDef htim7;
+extern DMA_HandleTypeDef hdma_usart3_tx;
+#if !ONE_WIRE_TIMER_TRANSPORT
+extern DMA_HandleTypeDef hdma_usart2_tx;
+#endif
+#if ONE_WIRE_UART_TRANSPORT
+extern DMA_HandleTypeDef hdma_usart1_rx;
+extern DMA_HandleTypeDef hdma_usart1_tx;
+extern UART_HandleTypeDef huart1;
+#endif
+#if ONE_WIRE_TIMER_TRANSPORT
+extern DMA_HandleTypeDef hdma_tim1_ch3;
+extern DMA_HandleTypeDef hdma_tim1_ch4;
+#endif
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -289,4 +302,80 @@ void USART3_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 channel2 global interrupt (USART3 TX).
+  */
+void DMA1_Channel2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart3_tx);
+}
+
+/**
+  * @brief This function handles TIM7 global interrupt (HX711 serial clock).
+  */
+void TIM7_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim7);
+}
+
+/**
+  * @brief This function handles EXTI line[9:5] interrupts (HX711 data ready).
+  */
+void EXTI9_5_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(HX711_DATA_Pin);
+}
+
+#if ONE_WIRE_UART_TRANSPORT
+/**
+  * @brief This function handles DMA1 channel4 global interrupt (1-wire UART TX).
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+/**
+  * @brief This function handles DMA1 channel5 global interrupt (1-wire UART RX).
+  */
+void DMA1_Channel5_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart1_rx);
+}
+
+/**
+  * @brief This function handles USART1 global interrupt (1-wire UART).
+  */
+void USART1_IRQHandler(void)
+{
+  HAL_UART_IRQHandler(&huart1);
+}
+#endif
+
+#if ONE_WIRE_TIMER_TRANSPORT
+/**
+  * @brief This function handles DMA1 channel4 global interrupt (1-wire TIM1 CH4 capture).
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_tim1_ch4);
+}
+
+/**
+  * @brief This function handles DMA1 channel7 global interrupt (1-wire TIM1 CH3 slots).
+  */
+void DMA1_Channel7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_tim1_ch3);
+}
+#else
+/**
+  * @brief This function handles DMA1 channel7 global interrupt (USART2 TX).
+  */
+void DMA1_Channel7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+}
+#endif
+
 /* USER CODE END 1 */
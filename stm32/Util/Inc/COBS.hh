@@ -1,3 +1,4 @@
+#pragma once
 
 #include <stddef.h>
 #include <stdint.h>
@@ -30,6 +31,80 @@ inline size_t EncodeCOBS(const uint8_t *ptr, size_t length, uint8_t *dst)
   return dst - start;
 }
 
+/*
+ * Maximum length of "length" bytes once encoded,
+ * without the framing byte.
+ */
+inline constexpr size_t MaxEncodedLengthCOBS(size_t length)
+{
+  return length + length / 254 + 1;
+}
+
+/*
+ * COBSEncoder byte stuffs data as it is written,
+ * producing the same output as EncodeCOBS. The
+ * output is written in place into two spans, the
+ * second one continuing the first (e.g. the free
+ * space of a ring buffer before and after it wraps).
+ *
+ * The spans must have room for
+ * MaxEncodedLengthCOBS(length) + 1 bytes.
+ */
+class COBSEncoder
+{
+  private:
+    uint8_t *_first;
+    size_t   _first_length;
+    uint8_t *_second;
+
+  private:
+    size_t  _cursor   = 1;
+    size_t  _code_pos = 0; /* Where to insert the leading count */
+    uint8_t _code     = 1;
+
+  public:
+    COBSEncoder(uint8_t *first, size_t first_length, uint8_t *second)
+        : _first(first), _first_length(first_length), _second(second)
+    {
+    }
+
+    void write(uint8_t byte)
+    {
+      if (byte) /* Input byte not zero */
+        at(_cursor++) = byte, ++_code;
+
+      if (!byte || _code == 0xFF) /* Input is zero or complete block */
+        at(_code_pos) = _code, _code = 1, _code_pos = _cursor++;
+    }
+
+    void write(size_t length, const void *value)
+    {
+      const uint8_t *ptr = static_cast<const uint8_t *>(value);
+
+      while (length--)
+        write(*ptr++);
+    }
+
+    /*
+     * Writes the final code and the framing byte.
+     *
+     * Returns the length of the frame.
+     */
+    size_t finish()
+    {
+      at(_code_pos) = _code; /* Final code */
+      at(_cursor++) = 0;
+
+      return _cursor;
+    }
+
+  private:
+    uint8_t &at(size_t pos)
+    {
+      return pos < _first_length ? _first[pos] : _second[pos - _first_length];
+    }
+};
+
 /*
  * DecodeCOBS decodes "length" bytes of data at
  * the location pointed to by "ptr", writing the
@@ -12,6 +12,7 @@
  *  - XorOut        = 0x0000
  *  - ReflectOut    = False
  *  - Algorithm     = table-driven
+ *  - TableIdxWidth = 8
  *
  * This file defines the functions crc_init(), crc_update() and crc_finalize().
  *
@@ -24,6 +25,11 @@
  * The crc_update() function can be called any number of times (including zero
  * times) in between the crc_init() and crc_finalize() calls.
  *
+ * crc_update() runs on the backend selected by CRC_HW_BACKEND (main.h): the CRC
+ * peripheral of the STM32, or a 256-entry table, the only one on host builds.
+ * Both give the same values. The hardware backend is not reentrant, crc_update()
+ * must not be called from interrupts.
+ *
  * This pseudo-code shows an example usage of the API:
  * \code{.c}
  * crc_t crc;
@@ -83,6 +89,16 @@ extern "C"
    */
   crc_t crc_update(crc_t crc, const void *data, size_t data_len);
 
+  /**
+   * Update the crc value with new data, using the table backend.
+   */
+  crc_t crc_update_table(crc_t crc, const void *data, size_t data_len);
+
+  /**
+   * Initialise the selected backend, before the first call to crc_update().
+   */
+  void crc_backend_init(void);
+
   /**
    * Calculate the final crc value.
    *
@@ -1,152 +1,252 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 
 #include "Math.hh"
 
-// Circular buffer of capacity N-1.
-template<class T, size_t N> class CircularBuffer
+// Behaviour of put() and put_bulk() when the buffer is full.
+enum class OverflowPolicy
 {
+  Reject,     // The new items are dropped
+  Overwrite   // The oldest items are overwritten
+};
+
+// Single-producer/single-consumer circular buffer of capacity N, N being a power of two.
+//
+// The producer (e.g. an ISR) only writes head_ and the consumer (e.g. the main loop) only
+// writes tail_. Both are free running counters masked on access, published with
+// release/acquire ordering, so no lock or critical section is needed.
+//
+// With OverflowPolicy::Overwrite the producer still never touches tail_: the consumer
+// detects that it has been lapped, skips the overwritten items and discards an item
+// overwritten while it was being read.
+//
+// The span functions let a DMA fill (reserve/commit) or drain (peek_contiguous/skip) the
+// buffer in place. They require OverflowPolicy::Reject.
+template<class T, size_t N, OverflowPolicy Policy = OverflowPolicy::Reject> class CircularBuffer
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "CircularBuffer size must be a power of two");
 
   private:
-    T      buf_[N];
-    size_t head_ = 0;
-    size_t tail_ = 0;
+    static constexpr size_t Mask = N - 1;
 
+  private:
+    T                   buf_[N];
+    std::atomic<size_t> head_{0};
+    std::atomic<size_t> tail_{0};
+
+    // Producer.
   public:
-    void put(T item)
+    bool put(T item)
     {
-      buf_[head_] = item;
+      const size_t head = head_.load(std::memory_order_relaxed);
 
-      if (full())
+      if (Policy == OverflowPolicy::Reject && head - tail_.load(std::memory_order_acquire) >= N)
       {
-        tail_ = (tail_ + 1) % N;
+        return false;
       }
 
-      head_ = (head_ + 1) % N;
+      buf_[head & Mask] = item;
+      head_.store(head + 1, std::memory_order_release);
+
+      return true;
     }
 
-    uint8_t put_bulk(T *items, size_t item_size)
+    size_t put_bulk(const T *items, size_t item_size)
     {
-      uint8_t buf_overflow = 0;
+      size_t       head    = head_.load(std::memory_order_relaxed);
+      const size_t written = (Policy == OverflowPolicy::Reject)
+                                 ? math::min(item_size, N - (head - tail_.load(std::memory_order_acquire)))
+                                 : item_size;
 
-      // Number of bytes to write at head
-      size_t size_head = math::min(math::min(item_size, N - head_), capacity());
+      item_size = written;
+      if (item_size > N)
+      {
+        // Overwrite, only the last N items survive
+        items += item_size - N;
+        head += item_size - N;
+        item_size = N;
+      }
 
-      // Number of bytes to write at the beginning of the buffer. 
-      // Make sure it does not write more bytes than the buffer capacity
-      size_t size_begin = math::min(capacity() - size_head, item_size - size_head);
+      // Number of items to write at head, then at the beginning of the buffer
+      const size_t size_head  = math::min(item_size, N - (head & Mask));
+      const size_t size_begin = item_size - size_head;
 
-      // Write data at head
-      memcpy((void *)&buf_[head_], (void *)items, size_head);
+      memcpy((void *)&buf_[head & Mask], (const void *)items, size_head * sizeof(T));
 
-      // Write data at the beginning of buf
       if (size_begin > 0)
       {
-        memcpy((void *)&buf_[0], (void *)&items[size_head], size_begin);
+        memcpy((void *)&buf_[0], (const void *)&items[size_head], size_begin * sizeof(T));
       }
 
-      // Specify whether the end of buf is reached 
-      if (size_head == N - head_)
-      {
-        buf_overflow = 1;
-      }
+      head_.store(head + item_size, std::memory_order_release);
 
-      // Store previous head
-      size_t prev_head = head_;
+      // Return number of written items
+      return written;
+    }
 
-      // Update head
-      head_ = (head_ + size_head + size_begin) % N;
+    // Returns the number of free items stored contiguously from the head, and a pointer to the first one.
+    size_t reserve(T **items)
+    {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      const size_t free = N - (head - tail_.load(std::memory_order_acquire));
 
-      // In case head_ overtakes tail_, update tail_
-      if ((tail_ > prev_head && (tail_ <= head_ || buf_overflow)) || (tail_ <= head_ && buf_overflow))
-      {
-        tail_ = (head_ + 1) % N;
-      }
+      *items = &buf_[head & Mask];
 
-      // Return number of written bytes
-      return size_head + size_begin;
+      return math::min(free, N - (head & Mask));
     }
 
+    // Same as reserve(T **), the free items wrapped to the beginning of the buffer are returned
+    // as a second span. Returns the total number of free items.
+    size_t reserve(T **items, size_t *item_size, T **wrapped_items, size_t *wrapped_size)
+    {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      const size_t free = N - (head - tail_.load(std::memory_order_acquire));
+
+      *items         = &buf_[head & Mask];
+      *item_size     = math::min(free, N - (head & Mask));
+      *wrapped_items = &buf_[0];
+      *wrapped_size  = free - *item_size;
+
+      return free;
+    }
+
+    // Publishes item_size items written in place after reserve().
+    void commit(size_t item_size)
+    {
+      head_.store(head_.load(std::memory_order_relaxed) + item_size, std::memory_order_release);
+    }
+
+    // Consumer.
+  public:
     T get()
     {
-      if (empty())
+      T item = T();
+
+      get(&item);
+
+      return item;
+    }
+
+    bool get(T *item)
+    {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+
+      while (true)
       {
-        return T();
-      }
+        size_t head = head_.load(std::memory_order_acquire);
+
+        if (head == tail)
+        {
+          return false;
+        }
+
+        if (Policy == OverflowPolicy::Overwrite && head - tail > N)
+        {
+          // Lapped by the producer, skip to the oldest item still stored
+          tail = head - N;
+        }
+
+        *item = buf_[tail & Mask];
 
-      const T data = buf_[tail_];
-      tail_        = (tail_ + 1) % N;
+        // Retry if the item was overwritten while it was copied
+        if (Policy == OverflowPolicy::Overwrite && head_.load(std::memory_order_acquire) - tail > N)
+        {
+          continue;
+        }
 
-      return data;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+      }
     }
 
     size_t get_bulk(T *items, size_t item_size)
     {
-      const size_t buf_size = size();
+      size_t read = 0;
+
+      if (Policy == OverflowPolicy::Overwrite)
+      {
+        while (read < item_size && get(&items[read]))
+        {
+          read++;
+        }
+        return read;
+      }
 
-      // Number of bytes to read from the tail 
-      size_t size_tail = math::min(math::min(item_size, N - tail_), buf_size);
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      item_size         = math::min(item_size, head_.load(std::memory_order_acquire) - tail);
 
-      // Number of bytes to read from the beginning of the buffer
-      size_t size_begin = math::min(buf_size - size_tail, item_size - size_tail);
+      // Number of items to read from the tail, then from the beginning of the buffer
+      const size_t size_tail  = math::min(item_size, N - (tail & Mask));
+      const size_t size_begin = item_size - size_tail;
 
-      // Get data from tail_
-      memcpy((void *)items, (void*)&buf_[tail_], size_tail);
+      memcpy((void *)items, (const void *)&buf_[tail & Mask], size_tail * sizeof(T));
 
       if (size_begin > 0)
       {
-        // Get data from the beginning of the buffer
-        memcpy((void *)&items[size_tail], (void *)buf_, size_begin);
+        memcpy((void *)&items[size_tail], (const void *)buf_, size_begin * sizeof(T));
       }
 
-      // Update tail_
-      tail_ = (tail_ + size_tail + size_begin) % N;
+      tail_.store(tail + item_size, std::memory_order_release);
 
-      // Return number of read bytes
-      return size_tail + size_begin;
+      // Return number of read items
+      return item_size;
+    }
+
+    // Returns the number of items stored contiguously from the tail, and a pointer to the first one.
+    // The items stay in the buffer until skip() is called.
+    size_t peek_contiguous(const T **items) const
+    {
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      const size_t size = head_.load(std::memory_order_acquire) - tail;
+
+      *items = &buf_[tail & Mask];
+
+      return math::min(size, N - (tail & Mask));
+    }
+
+    // Drops up to item_size items from the tail.
+    void skip(size_t item_size)
+    {
+      tail_.store(tail_.load(std::memory_order_relaxed) + math::min(item_size, size()),
+                  std::memory_order_release);
     }
 
     void reset()
     {
-      head_ = tail_;
+      tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
     }
 
+    // Either side.
+  public:
     bool empty() const
     {
-      return (head_ == tail_);
+      return size() == 0;
     }
 
     bool full() const
     {
-      return ((head_ + 1) % N) == tail_;
+      return size() == N;
     }
 
     size_t capacity() const
     {
-      return N - 1;
+      return N;
     }
 
     size_t size() const
     {
-      size_t size = N;
-
-      if (head_ >= tail_)
-      {
-        size = head_ - tail_;
-      }
-      else
-      {
-        size = N + head_ - tail_;
-      }
+      const size_t tail = tail_.load(std::memory_order_acquire);
+      const size_t head = head_.load(std::memory_order_acquire);
 
-      return size;
+      return math::min(head - tail, N);
     }
 
     size_t available() const
     {
-      return N - 1 - size();
+      return N - size();
     }
 };
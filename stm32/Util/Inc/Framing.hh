@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "COBS.hh"
+#include "CRC.hh"
+
+// Framing shared by the telemetry and command channels: the message bytes followed by their
+// CRC16 (big endian), COBS encoded and terminated by a zero framing byte. A receiver
+// resynchronises on the next zero byte after any corruption.
+
+// Maximum length of the frame of a message of "length" bytes.
+inline constexpr size_t MaxFrameLength(size_t length)
+{
+  return MaxEncodedLengthCOBS(length + 2) + 1;
+}
+
+// Encodes a message as it is written, into two spans (see COBSEncoder) with room for
+// MaxFrameLength() bytes.
+class FrameEncoder
+{
+  private:
+    COBSEncoder _cobs;
+  private:
+    crc_t _crc = crc_init();
+
+  public:
+    FrameEncoder(uint8_t *first, size_t first_length, uint8_t *second) : _cobs(first, first_length, second) {}
+
+  public:
+    void write(uint8_t byte)
+    {
+      _crc = crc_update(_crc, &byte, 1);
+      _cobs.write(byte);
+    }
+
+  public:
+    void write(size_t length, const void *value)
+    {
+      _crc = crc_update(_crc, value, length);
+      _cobs.write(length, value);
+    }
+
+    // Appends the CRC and the framing byte, returns the length of the frame.
+  public:
+    size_t finish()
+    {
+      const crc_t crc = crc_finalize(_crc);
+      _cobs.write(uint8_t(crc >> 8));
+      _cobs.write(uint8_t(crc));
+
+      return _cobs.finish();
+    }
+};
+
+// Decodes frames of messages of up to N bytes as their bytes are received, without buffering
+// the encoded frame.
+template<size_t N> class FrameDecoder
+{
+  private:
+    // Decoded message followed by its CRC
+    uint8_t _buf[N + 2];
+    size_t  _length = 0;
+  private:
+    // Length of the last valid message
+    size_t _message_length = 0;
+  private:
+    uint8_t _code     = 0xFF; // Code of the current COBS block
+    uint8_t _copy     = 0;    // Bytes left in the current COBS block
+    bool    _overflow = false;
+  private:
+    uint32_t _invalid_frames = 0;
+
+    // Feeds a received byte, returns true if it ends a valid frame. The message is then
+    // available through data() and length() until the next call.
+  public:
+    bool put(uint8_t byte)
+    {
+      if (byte == 0)
+      {
+        const bool valid = !_overflow && _copy == 0 && _length > 2
+                           && crc_finalize(crc_update(crc_init(), _buf, _length)) == 0;
+
+        // Consecutive framing bytes delimit empty frames, which are ignored
+        if (!valid && (_length > 0 || _overflow))
+        {
+          ++_invalid_frames;
+        }
+
+        _message_length = valid ? _length - 2 : 0;
+        _length         = 0;
+        _code           = 0xFF;
+        _copy           = 0;
+        _overflow       = false;
+
+        return valid;
+      }
+
+      if (_copy == 0)
+      {
+        // Code byte, a block shorter than 254 bytes was followed by a zero
+        if (_code != 0xFF)
+        {
+          append(0);
+        }
+        _code = byte;
+        _copy = byte - 1;
+      }
+      else
+      {
+        append(byte);
+        --_copy;
+      }
+
+      return false;
+    }
+
+  public:
+    const uint8_t *data() const
+    {
+      return _buf;
+    }
+
+  public:
+    size_t length() const
+    {
+      return _message_length;
+    }
+
+  public:
+    uint32_t get_invalid_frames() const
+    {
+      return _invalid_frames;
+    }
+
+  private:
+    void append(uint8_t byte)
+    {
+      if (_length < sizeof(_buf))
+      {
+        _buf[_length++] = byte;
+      }
+      else
+      {
+        _overflow = true;
+      }
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary min-heap of up to N items, without dynamic allocation. Less(a, b) returns true if a
+// must be popped before b. Items that compare equal are popped in insertion order.
+//
+// push() and pop() are O(log N), top() is O(1). Not thread safe.
+template<class T, size_t N, class Less> class MinHeap
+{
+    static_assert(N > 0, "MinHeap size must be positive");
+
+  private:
+    struct Entry
+    {
+        T        item;
+        uint32_t order; // Insertion counter, breaks ties
+    };
+
+  private:
+    Entry    heap_[N];
+    size_t   size_  = 0;
+    uint32_t order_ = 0;
+  private:
+    Less less_;
+
+  public:
+    bool push(const T &item)
+    {
+      if (size_ == N)
+      {
+        return false;
+      }
+
+      // Sift the new entry up from the last leaf
+      size_t i = size_++;
+      Entry  entry{item, order_++};
+
+      while (i > 0 && before(entry, heap_[(i - 1) / 2]))
+      {
+        heap_[i] = heap_[(i - 1) / 2];
+        i        = (i - 1) / 2;
+      }
+      heap_[i] = entry;
+
+      return true;
+    }
+
+    // Removes the top item, returns false if the heap is empty.
+  public:
+    bool pop(T *item)
+    {
+      if (size_ == 0)
+      {
+        return false;
+      }
+
+      *item = heap_[0].item;
+
+      // Sift the last entry down from the root
+      const Entry last = heap_[--size_];
+      size_t      i    = 0;
+
+      while (2 * i + 1 < size_)
+      {
+        size_t child = 2 * i + 1;
+        if (child + 1 < size_ && before(heap_[child + 1], heap_[child]))
+        {
+          child++;
+        }
+        if (!before(heap_[child], last))
+        {
+          break;
+        }
+        heap_[i] = heap_[child];
+        i        = child;
+      }
+      heap_[i] = last;
+
+      return true;
+    }
+
+    // Item to be popped next, the heap must not be empty.
+  public:
+    const T &top() const
+    {
+      return heap_[0].item;
+    }
+
+  public:
+    bool empty() const
+    {
+      return size_ == 0;
+    }
+
+  public:
+    bool full() const
+    {
+      return size_ == N;
+    }
+
+  public:
+    size_t size() const
+    {
+      return size_;
+    }
+
+  public:
+    void clear()
+    {
+      size_ = 0;
+    }
+
+  private:
+    bool before(const Entry &a, const Entry &b) const
+    {
+      if (less_(a.item, b.item))
+      {
+        return true;
+      }
+      if (less_(b.item, a.item))
+      {
+        return false;
+      }
+      return int32_t(a.order - b.order) < 0;
+    }
+};
@@ -3,6 +3,39 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// Bytes to be written, see StreamInterface::write(const ConstSpan *, size_t).
+struct ConstSpan
+{
+    const uint8_t *data;
+    size_t         len;
+};
+
+// Free space to be written in place, see StreamInterface::reserve().
+struct MutableSpan
+{
+    uint8_t *data;
+    size_t   len;
+};
+
+// Transmit queues of a stream, in decreasing priority order.
+enum class StreamLane : uint8_t
+{
+  Control,     // Command acknowledgements
+  Telemetry,   // Periodic telemetry
+  Bulk         // Dumps, sent when nothing else is pending
+};
+
+constexpr size_t StreamLaneCount = 3;
+
+// Transmit statistics of a lane.
+struct StreamStats
+{
+    uint32_t dropped_messages;
+    uint32_t dropped_bytes;
+    uint16_t high_water;   // Max number of bytes queued
+    uint16_t capacity;
+};
+
 class StreamInterface
 {
     // Returns the number of bytes available in the read buffer.
@@ -16,4 +49,54 @@ class StreamInterface
     // Writes a buffer of bytes, returning the number of bytes written, which may be less than len.
   public:
     virtual size_t write(const uint8_t *buf, size_t len) = 0;
+
+    // Writes count buffers back to back, returning the number of bytes written.
+    // Streams with a transmit buffer write either all the spans or none of them.
+  public:
+    virtual size_t write(const ConstSpan *spans, size_t count)
+    {
+      size_t written = 0;
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        const size_t len = write(spans[i].data, spans[i].len);
+        written += len;
+
+        if (len < spans[i].len)
+        {
+          break;
+        }
+      }
+
+      return written;
+    }
+
+    // Returns the free space of the transmit buffer as up to two spans, the second one
+    // following the first on the wire, and their total length. Bytes written there are
+    // sent once commit() is called. len is the size of the message to be written, the
+    // message is accounted as dropped if it doesn't fit.
+    // Streams that can't be written in place return null spans.
+  public:
+    virtual size_t reserve(MutableSpan spans[2], size_t len)
+    {
+      (void)len;
+      spans[0] = spans[1] = MutableSpan {nullptr, 0};
+      return 0;
+    }
+
+    // Sends the first len bytes of the spans returned by the last reserve().
+  public:
+    virtual void commit(size_t len)
+    {
+      (void)len;
+    }
+
+    // Copies the transmit statistics of a lane, returns false if the stream doesn't keep any.
+  public:
+    virtual bool get_stats(StreamLane lane, StreamStats *stats) const
+    {
+      (void)lane;
+      (void)stats;
+      return false;
+    }
 };
@@ -28,6 +28,10 @@ const uint8_t MSG_TAG_PILOT_COMMAND           = 0x22; // 34
 const uint8_t MSG_TAG_SBUS_ACK                = 0x23; // 35
 const uint8_t MSG_TAG_VOTING_STATUS           = 0x24; // 36
 const uint8_t MSG_TAG_STREAM_STATUS           = 0x25; // 37
+const uint8_t MSG_TAG_TEST_PLAN               = 0x27; // 39
+const uint8_t MSG_TAG_PARAM_VALUE             = 0x28; // 40
+const uint8_t MSG_TAG_RIG_STATE               = 0x29; // 41
+const uint8_t MSG_TAG_SIMULTANEOUS_SAMPLES    = 0x2B; // 43
 const uint8_t MSG_TAG_INTERNAL_STATES         = 0x2A; // 42
 const uint8_t MSG_TAG_ANGULAR_RATES           = 0x30; // 48
 const uint8_t MSG_TAG_ATTITUDE_QUAT           = 0x31; // 49
@@ -49,6 +53,8 @@ const uint8_t MSG_TAG_GPS_HPPOSLLH            = 0x50; // 80
 const uint8_t MSG_TAG_CURRENT                 = 0x53; // 83
 const uint8_t MSG_TAG_VOLTAGE                 = 0x54; // 84
 const uint8_t MSG_TAG_TEMPERATURE             = 0x55; // 85
+const uint8_t MSG_TAG_CURRENT_PROFILE         = 0x56; // 86
+const uint8_t MSG_TAG_LOAD_CELL               = 0x57; // 87
 const uint8_t MSG_TAG_RADAR_ALT_USD1          = 0x58; // 88
 const uint8_t MSG_TAG_ACCELEROMETER           = 0x59; // 89
 const uint8_t MSG_TAG_MAGNETOMETER            = 0x5A; // 90
@@ -119,6 +125,14 @@ const uint8_t DEVSENSE_WINGTILT_R = 0x0C;
 const uint8_t TIMER_ID_WORKING       = 0x01;
 const uint8_t TIMER_ID_LOOP_INTERVAL = 0x02;
 
+const uint8_t CURRENT_PROFILE_POINTS_MAX = 8;
+
+const uint8_t TEST_PLAN_EVENT_STARTED  = 0x01;
+const uint8_t TEST_PLAN_EVENT_STEP     = 0x02;
+const uint8_t TEST_PLAN_EVENT_FINISHED = 0x03;
+const uint8_t TEST_PLAN_EVENT_ABORTED  = 0x04;
+const uint8_t TEST_PLAN_EVENT_TIMEOUT  = 0x05;
+
 #pragma pack(push, 1)
 
 struct sequence_msg
@@ -133,6 +147,86 @@ struct debug_msg
 	float value;
 };
 
+// Sensor values and reference of a control step, sent every step
+struct rig_state_msg
+{
+	int32_t load_cell_adc_val;
+	uint16_t mag_feedback_adc_val;
+	uint16_t pot_feedback_adc_val;
+	float reference_deg;
+	float supply_current_a;
+	float supply_voltage_v;
+	float temperature_degc;				// First temperature sensor
+};
+
+// Raw position and current ADC values converted at the same instant by ADC1 and ADC2
+struct simultaneous_samples_msg
+{
+	uint16_t mag_position_adc_val;		// Unfiltered
+	uint16_t mag_current_adc_val;
+	uint16_t pot_position_adc_val;
+	uint16_t pot_current_adc_val;
+};
+
+struct current_profile_msg
+{
+	uint32_t frame;
+	uint8_t n_points;
+	uint16_t offset_us[CURRENT_PROFILE_POINTS_MAX];
+	float current_a[CURRENT_PROFILE_POINTS_MAX];
+};
+
+struct temperature_msg
+{
+	uint16_t sensor_id;
+	float temperature_degc;
+};
+
+struct load_cell_msg
+{
+	uint32_t timestamp_us;
+	int32_t value;
+	uint8_t gain;
+};
+
+struct pilot_cmd_ack_msg
+{
+	uint16_t sequence;
+	uint8_t command;
+	uint8_t status;
+	uint32_t received_us;
+	uint32_t applied_us;
+};
+
+struct test_plan_msg
+{
+	uint8_t event;
+	uint8_t step;
+	uint8_t type;
+	uint32_t loops;				// Loop jumps since the start of the plan
+	uint32_t time_us;
+};
+
+// Values as their raw 4 bytes, of the given type
+struct param_value_msg
+{
+	uint8_t id;
+	uint8_t type;
+	uint32_t value;
+	uint32_t min;
+	uint32_t max;
+	uint32_t default_value;
+};
+
+struct stream_status_msg
+{
+	uint8_t lane;
+	uint32_t dropped_messages;
+	uint32_t dropped_bytes;
+	uint16_t high_water;
+	uint16_t capacity;
+};
+
 #pragma pack(pop)
 
 class SerialWriter
@@ -143,18 +237,42 @@ class SerialWriter
   private:
     uint8_t sequence_number = 0;
 
+  private:
+    // Free space reserved for the frames of the current batch, and the bytes written there.
+    MutableSpan batch_spans[2] = {};
+    size_t      batch_length = 0;
+    bool        batching     = false;
+
   public:
     SerialWriter(StreamInterface *stream);
   public:
     void write_message(uint8_t tag, uint8_t length, const void *value);
+
+    // The messages written between begin_batch() and end_batch() are encoded back to back
+    // into the transmit buffer reserved once, and sent with a single commit. Each message keeps
+    // its own frame. The stream must have no other writer until end_batch().
+  public:
+    void begin_batch();
+  public:
+    void end_batch();
   public:
     void write_sequence_message();
+  public:
+    // Reports the transmit statistics of each lane of the stream.
+    void write_stream_status_messages();
 
   public:
     template<class T> void write_message(uint8_t tag, const T &value)
     {
       write_message(tag, sizeof(value), &value);
     }
+
+  private:
+    bool write_batched(uint8_t tag, uint8_t length, const void *value, size_t frame_length);
+  private:
+    static size_t encode_frame(const MutableSpan spans[2], uint8_t tag, uint8_t length, const void *value);
+  private:
+    void write_copied(uint8_t tag, uint8_t length, const void *value);
 };
 
 } // namespace telem
@@ -12,42 +12,112 @@
  *  - XorOut        = 0x0000
  *  - ReflectOut    = False
  *  - Algorithm     = table-driven
+ *  - TableIdxWidth = 8
  */
 
 #include "CRC.hh"
 
+#if defined(USE_HAL_DRIVER)
+#include "main.h"
+#include <string.h>
+#endif
+
+#ifndef CRC_HW_BACKEND
+#define CRC_HW_BACKEND 0
+#endif
+
 /**
  * Static table used for the table_driven implementation.
  */
-static const crc_t crc_table[16] = {0x0000,
-                                    0x011b,
-                                    0x0236,
-                                    0x032d,
-                                    0x046c,
-                                    0x0577,
-                                    0x065a,
-                                    0x0741,
-                                    0x08d8,
-                                    0x09c3,
-                                    0x0aee,
-                                    0x0bf5,
-                                    0x0cb4,
-                                    0x0daf,
-                                    0x0e82,
-                                    0x0f99};
+static const crc_t crc_table[256] = {
+    0x0000, 0x011b, 0x0236, 0x032d, 0x046c, 0x0577, 0x065a, 0x0741,
+    0x08d8, 0x09c3, 0x0aee, 0x0bf5, 0x0cb4, 0x0daf, 0x0e82, 0x0f99,
+    0x11b0, 0x10ab, 0x1386, 0x129d, 0x15dc, 0x14c7, 0x17ea, 0x16f1,
+    0x1968, 0x1873, 0x1b5e, 0x1a45, 0x1d04, 0x1c1f, 0x1f32, 0x1e29,
+    0x2360, 0x227b, 0x2156, 0x204d, 0x270c, 0x2617, 0x253a, 0x2421,
+    0x2bb8, 0x2aa3, 0x298e, 0x2895, 0x2fd4, 0x2ecf, 0x2de2, 0x2cf9,
+    0x32d0, 0x33cb, 0x30e6, 0x31fd, 0x36bc, 0x37a7, 0x348a, 0x3591,
+    0x3a08, 0x3b13, 0x383e, 0x3925, 0x3e64, 0x3f7f, 0x3c52, 0x3d49,
+    0x46c0, 0x47db, 0x44f6, 0x45ed, 0x42ac, 0x43b7, 0x409a, 0x4181,
+    0x4e18, 0x4f03, 0x4c2e, 0x4d35, 0x4a74, 0x4b6f, 0x4842, 0x4959,
+    0x5770, 0x566b, 0x5546, 0x545d, 0x531c, 0x5207, 0x512a, 0x5031,
+    0x5fa8, 0x5eb3, 0x5d9e, 0x5c85, 0x5bc4, 0x5adf, 0x59f2, 0x58e9,
+    0x65a0, 0x64bb, 0x6796, 0x668d, 0x61cc, 0x60d7, 0x63fa, 0x62e1,
+    0x6d78, 0x6c63, 0x6f4e, 0x6e55, 0x6914, 0x680f, 0x6b22, 0x6a39,
+    0x7410, 0x750b, 0x7626, 0x773d, 0x707c, 0x7167, 0x724a, 0x7351,
+    0x7cc8, 0x7dd3, 0x7efe, 0x7fe5, 0x78a4, 0x79bf, 0x7a92, 0x7b89,
+    0x8d80, 0x8c9b, 0x8fb6, 0x8ead, 0x89ec, 0x88f7, 0x8bda, 0x8ac1,
+    0x8558, 0x8443, 0x876e, 0x8675, 0x8134, 0x802f, 0x8302, 0x8219,
+    0x9c30, 0x9d2b, 0x9e06, 0x9f1d, 0x985c, 0x9947, 0x9a6a, 0x9b71,
+    0x94e8, 0x95f3, 0x96de, 0x97c5, 0x9084, 0x919f, 0x92b2, 0x93a9,
+    0xaee0, 0xaffb, 0xacd6, 0xadcd, 0xaa8c, 0xab97, 0xa8ba, 0xa9a1,
+    0xa638, 0xa723, 0xa40e, 0xa515, 0xa254, 0xa34f, 0xa062, 0xa179,
+    0xbf50, 0xbe4b, 0xbd66, 0xbc7d, 0xbb3c, 0xba27, 0xb90a, 0xb811,
+    0xb788, 0xb693, 0xb5be, 0xb4a5, 0xb3e4, 0xb2ff, 0xb1d2, 0xb0c9,
+    0xcb40, 0xca5b, 0xc976, 0xc86d, 0xcf2c, 0xce37, 0xcd1a, 0xcc01,
+    0xc398, 0xc283, 0xc1ae, 0xc0b5, 0xc7f4, 0xc6ef, 0xc5c2, 0xc4d9,
+    0xdaf0, 0xdbeb, 0xd8c6, 0xd9dd, 0xde9c, 0xdf87, 0xdcaa, 0xddb1,
+    0xd228, 0xd333, 0xd01e, 0xd105, 0xd644, 0xd75f, 0xd472, 0xd569,
+    0xe820, 0xe93b, 0xea16, 0xeb0d, 0xec4c, 0xed57, 0xee7a, 0xef61,
+    0xe0f8, 0xe1e3, 0xe2ce, 0xe3d5, 0xe494, 0xe58f, 0xe6a2, 0xe7b9,
+    0xf990, 0xf88b, 0xfba6, 0xfabd, 0xfdfc, 0xfce7, 0xffca, 0xfed1,
+    0xf148, 0xf053, 0xf37e, 0xf265, 0xf524, 0xf43f, 0xf712, 0xf609};
 
-crc_t crc_update(crc_t crc, const void *data, size_t data_len)
+crc_t crc_update_table(crc_t crc, const void *data, size_t data_len)
 {
   const unsigned char *d = (const unsigned char *)data;
   unsigned int         tbl_idx;
 
   while (data_len--)
   {
-    tbl_idx = (crc >> 12) ^ (*d >> 4);
-    crc     = crc_table[tbl_idx & 0x0f] ^ (crc << 4);
-    tbl_idx = (crc >> 12) ^ (*d >> 0);
-    crc     = crc_table[tbl_idx & 0x0f] ^ (crc << 4);
+    tbl_idx = ((crc >> 8) ^ *d) & 0xff;
+    crc     = (crc_table[tbl_idx] ^ (crc << 8)) & 0xffff;
     d++;
   }
   return crc & 0xffff;
 }
+
+#if CRC_HW_BACKEND
+
+void crc_backend_init(void)
+{
+  __HAL_RCC_CRC_CLK_ENABLE();
+
+  // 16-bit polynomial, input and output not reflected
+  CRC->POL = 0x011b;
+  CRC->CR  = CRC_CR_POLYSIZE_0;
+}
+
+crc_t crc_update(crc_t crc, const void *data, size_t data_len)
+{
+  const unsigned char *d = (const unsigned char *)data;
+
+  // Resume from the given value, the unit may have been used for another message since
+  CRC->INIT = crc;
+  CRC->CR |= CRC_CR_RESET;
+
+  // Words are processed from their most significant byte, swapped to keep the byte order
+  for (; data_len >= 4; data_len -= 4, d += 4)
+  {
+    uint32_t word;
+    memcpy(&word, d, sizeof(word));
+    CRC->DR = __REV(word);
+  }
+  while (data_len--)
+  {
+    *(__IO uint8_t *)&CRC->DR = *d++;
+  }
+
+  return CRC->DR & 0xffff;
+}
+
+#else
+
+void crc_backend_init(void) {}
+
+crc_t crc_update(crc_t crc, const void *data, size_t data_len)
+{
+  return crc_update_table(crc, data, data_len);
+}
+
+#endif
@@ -1,7 +1,7 @@
 
 #include "Telemetry.hh"
 
-#include "COBS.hh"
+#include "Framing.hh"
 #include "Math.hh"
 
 namespace telem
@@ -16,28 +16,112 @@ SerialWriter::SerialWriter(StreamInterface *stream) : stream(stream)
 
 void SerialWriter::write_message(uint8_t tag, uint8_t length, const void *value)
 {
-  uint8_t      message_buffer[300];
-  BufferWriter bufferWriter(message_buffer, sizeof(message_buffer));
-  bufferWriter << tag;
-  bufferWriter.write(length, value);
+  // Tag and value.
+  const size_t frame_length = MaxFrameLength(size_t(length) + 1);
 
-  // CRC calculation.
-  const uint16_t crc16 = crc_finalize(crc_update(crc_init(), message_buffer, size_t(length) + 1));
-  bufferWriter << reinterpret_cast<const uint8_t *>(&crc16)[1];
-  bufferWriter << reinterpret_cast<const uint8_t *>(&crc16)[0];
+  if (!(batching && write_batched(tag, length, value, frame_length)))
+  {
+    // The frame is encoded in place into the transmit buffer of the stream, or into a
+    // local buffer for streams that can't be written in place.
+    MutableSpan spans[2];
+    stream->reserve(spans, frame_length);
 
-  uint8_t message_cobs_buffer[sizeof(message_buffer) + 10];
-  size_t  message_cobs_length                = EncodeCOBS(message_buffer, bufferWriter.length(), message_cobs_buffer);
-  message_cobs_buffer[message_cobs_length++] = 0; // COBS framing byte
-
-  stream->write(message_cobs_buffer, message_cobs_length);
+    if (spans[0].data == nullptr)
+    {
+      write_copied(tag, length, value);
+    }
+    else if (spans[0].len + spans[1].len >= frame_length)
+    {
+      stream->commit(encode_frame(spans, tag, length, value));
+    }
+    // Otherwise there's not enough space to enqueue this message.
+  }
 
   ++sequence_number;
 }
 
+void SerialWriter::begin_batch()
+{
+  // Reserving no length doesn't account the batch as dropped, each message is checked as it
+  // is written instead.
+  stream->reserve(batch_spans, 0);
+  batch_length = 0;
+  batching     = batch_spans[0].data != nullptr;
+}
+
+void SerialWriter::end_batch()
+{
+  if (batching && batch_length > 0)
+  {
+    stream->commit(batch_length);
+  }
+  batching = false;
+}
+
+bool SerialWriter::write_batched(uint8_t tag, uint8_t length, const void *value, size_t frame_length)
+{
+  // Free space left after the frames of the batch.
+  MutableSpan spans[2];
+  if (batch_length < batch_spans[0].len)
+  {
+    spans[0] = MutableSpan {batch_spans[0].data + batch_length, batch_spans[0].len - batch_length};
+    spans[1] = batch_spans[1];
+  }
+  else
+  {
+    const size_t wrapped = batch_length - batch_spans[0].len;
+    spans[0]             = MutableSpan {batch_spans[1].data + wrapped, batch_spans[1].len - wrapped};
+    spans[1]             = MutableSpan {nullptr, 0};
+  }
+
+  if (spans[0].len + spans[1].len < frame_length)
+  {
+    // Send the frames already encoded, the remaining messages are written one by one so
+    // that the stream accounts those that don't fit as dropped.
+    end_batch();
+    return false;
+  }
+
+  batch_length += encode_frame(spans, tag, length, value);
+
+  return true;
+}
+
+size_t SerialWriter::encode_frame(const MutableSpan spans[2], uint8_t tag, uint8_t length, const void *value)
+{
+  FrameEncoder encoder(spans[0].data, spans[0].len, spans[1].data);
+  encoder.write(tag);
+  encoder.write(length, value);
+
+  return encoder.finish();
+}
+
+// Not inlined, so that the local buffer is only on the stack of streams without in place writes.
+__attribute__((noinline)) void SerialWriter::write_copied(uint8_t tag, uint8_t length, const void *value)
+{
+  uint8_t           message_cobs_buffer[MaxFrameLength(UINT8_MAX + 1)];
+  const MutableSpan spans[2] = {{message_cobs_buffer, sizeof(message_cobs_buffer)}, {nullptr, 0}};
+
+  stream->write(message_cobs_buffer, encode_frame(spans, tag, length, value));
+}
+
 void SerialWriter::write_sequence_message()
 {
   write_message(MSG_TAG_SEQUENCE, sequence_msg {VERSION_MARKER_0_3, sequence_number});
 }
 
+void SerialWriter::write_stream_status_messages()
+{
+  for (size_t lane = 0; lane < StreamLaneCount; ++lane)
+  {
+    StreamStats stats;
+    if (stream->get_stats(StreamLane(lane), &stats))
+    {
+      write_message(MSG_TAG_STREAM_STATUS,
+                    stream_status_msg {uint8_t(lane), stats.dropped_messages, stats.dropped_bytes,
+                                       stats.high_water, stats.capacity});
+    }
+  }
+}
+
 } // namespace telem